@@ -0,0 +1,49 @@
+#version 460 core
+
+uniform mat4 u_viewProj;
+uniform vec3 u_viewPos;
+uniform vec3 u_sunDir;
+uniform float u_blendDay;
+
+in VS_OUT
+{
+    vec3 vPosition;
+    flat vec3 vCenter;
+    flat float vRadius;
+    flat vec3 vGlow;
+}fs_in;
+
+out vec4 fragColor;
+
+void main()
+{
+    // intersect the view ray with the sphere, and discard the parts of the quad that miss it
+    vec3 rayDir = normalize(fs_in.vPosition - u_viewPos);
+    vec3 oc = u_viewPos - fs_in.vCenter;
+    float b = dot(oc, rayDir);
+    float c = dot(oc, oc) - fs_in.vRadius * fs_in.vRadius;
+    float h = b * b - c;
+    if (h < 0.0) discard;
+
+    vec3 hit = u_viewPos + rayDir * (-b - sqrt(h));
+    vec3 N = normalize(hit - fs_in.vCenter);
+
+    // write the depth of the sphere's surface instead of the quad's, so intersections with other geometry are correct
+    vec4 clip = u_viewProj * vec4(hit, 1.0);
+    gl_FragDepth = clip.z / clip.w;
+
+    // same lighting as standard.frag.glsl for a white surface
+    vec3 sunDay = vec3(1);
+    vec3 sunNight = vec3(0.3);
+    vec3 sun = mix(sunNight, sunDay, u_blendDay);
+
+    float NoL = max(0.0, dot(N, -u_sunDir));
+    vec3 sunLit = clamp(min(u_blendDay, 0.9) * NoL * sun + sun * 0.05, vec3(0), vec3(1));
+
+    vec3 groundColor = vec3(125.0 / 255, 46.0 / 255, 30.0 / 255);
+    float groundDot = clamp(dot(-N, vec3(0, 1, 0)) + .3, 0.0, 1.0);
+    vec3 groundLit = groundColor * groundDot;
+
+    vec3 finalColor = fs_in.vGlow + sunLit + groundLit + (0.04 * (N * 0.5 + 0.5));
+    fragColor = vec4(finalColor, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 460 core
+
+// must match GFX::ParticleInstance
+struct Particle
+{
+    vec3 position;
+    float radius;
+    vec3 glow;
+    float _padding;
+};
+
+layout(std430, binding = 0) readonly buffer Particles
+{
+    Particle particles[];
+};
+
+uniform mat4 u_viewProj;
+uniform vec3 u_viewPos;
+uniform vec3 u_viewUp;
+
+out VS_OUT
+{
+    vec3 vPosition;
+    flat vec3 vCenter;
+    flat float vRadius;
+    flat vec3 vGlow;
+}vs_out;
+
+void main()
+{
+    Particle p = particles[gl_InstanceID];
+
+    // camera-facing quad, pushed toward the camera by the radius so it covers the sphere's whole silhouette
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 toView = normalize(u_viewPos - p.position);
+    vec3 right = normalize(cross(u_viewUp, toView));
+    vec3 up = cross(toView, right);
+
+    vs_out.vPosition = p.position + (toView + right * corner.x + up * corner.y) * p.radius;
+    vs_out.vCenter = p.position;
+    vs_out.vRadius = p.radius;
+    vs_out.vGlow = p.glow;
+
+    gl_Position = u_viewProj * vec4(vs_out.vPosition, 1.0);
+}
\ No newline at end of file
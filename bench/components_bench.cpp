@@ -0,0 +1,160 @@
+// iteration throughput of the structure-of-arrays entity storage against the array-of-structures GameObject layout
+// it replaced, at 1k, 10k and 100k entities. Each pass only needs a few components, like the loops in the game:
+// moving transforms, resetting the glow of explosives, and gathering what the renderer submits
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include "components.h"
+#include "game/component_storage.h"
+
+namespace
+{
+  struct EntityId
+  {
+    uint32_t index{};
+    uint32_t version{};
+  };
+
+  // per-entity state of the old layout, which every entity carried whether it used it or not
+  struct Particle
+  {
+    glm::vec3 velocity{};
+    glm::vec3 acceleration{};
+    float life{};
+  };
+
+  struct AosObject
+  {
+    EntityId entity;
+    EntityType type{};
+    Transform transform;
+    MeshHandle mesh;
+    Renderable renderable;
+    PhysicsFlags physics;
+    Particle particle;
+  };
+
+  using SoaStorage = Game::ComponentStorage<EntityId, EntityType, Transform, MeshHandle, Renderable, PhysicsFlags>;
+
+  constexpr glm::vec3 GLOW{ .5f, .2f, 0 };
+  volatile float sink; // keeps the compiler from dropping work whose result is never used
+
+  // runs pass until at least 100 ms have gone by and returns millions of entities per second
+  template<typename Fn>
+  double Measure(size_t count, Fn&& pass)
+  {
+    using clock = std::chrono::steady_clock;
+    pass(); // warm up caches
+    size_t repetitions = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration{};
+    do
+    {
+      pass();
+      repetitions++;
+      elapsed = clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(100));
+    return count * repetitions / std::chrono::duration<double, std::micro>(elapsed).count();
+  }
+
+  EntityType TypeOf(size_t i)
+  {
+    return EntityType(i % size_t(EntityType::COUNT));
+  }
+
+  void Run(size_t count)
+  {
+    std::vector<AosObject> aos(count);
+    SoaStorage soa;
+    for (size_t i = 0; i < count; i++)
+    {
+      aos[i].entity = { static_cast<uint32_t>(i), 1 };
+      aos[i].type = TypeOf(i);
+      aos[i].transform.position = glm::vec3(float(i));
+      soa.PushBack(EntityId{ static_cast<uint32_t>(i), 1 }, TypeOf(i), aos[i].transform, MeshHandle{}, Renderable{}, PhysicsFlags{});
+    }
+
+    const float dt = 0.01f;
+    const glm::vec3 velocity{ 0, -1, 0 };
+
+    const double aosMove = Measure(count, [&]
+      {
+        for (auto& object : aos)
+        {
+          object.transform.position += velocity * dt;
+        }
+      });
+    const double soaMove = Measure(count, [&]
+      {
+        soa.ForEachChunk<Transform>([&](size_t n, Transform* transforms)
+          {
+            for (size_t i = 0; i < n; i++)
+            {
+              transforms[i].position += velocity * dt;
+            }
+          });
+      });
+
+    const double aosGlow = Measure(count, [&]
+      {
+        for (auto& object : aos)
+        {
+          if (object.type == EntityType::EXPLOSIVE)
+          {
+            object.renderable.glow = GLOW;
+          }
+        }
+      });
+    const double soaGlow = Measure(count, [&]
+      {
+        soa.ForEachChunk<EntityType, Renderable>([&](size_t n, const EntityType* types, Renderable* renderables)
+          {
+            for (size_t i = 0; i < n; i++)
+            {
+              if (types[i] == EntityType::EXPLOSIVE)
+              {
+                renderables[i].glow = GLOW;
+              }
+            }
+          });
+      });
+
+    const double aosSubmit = Measure(count, [&]
+      {
+        float sum = 0;
+        for (const auto& object : aos)
+        {
+          sum += object.transform.position.y + object.renderable.color.x + float(object.mesh.count);
+        }
+        sink = sum;
+      });
+    const double soaSubmit = Measure(count, [&]
+      {
+        float sum = 0;
+        soa.ForEachChunk<Transform, MeshHandle, Renderable>([&](size_t n, const Transform* transforms,
+          const MeshHandle* meshes, const Renderable* renderables)
+          {
+            for (size_t i = 0; i < n; i++)
+            {
+              sum += transforms[i].position.y + renderables[i].color.x + float(meshes[i].count);
+            }
+          });
+        sink = sum;
+      });
+
+    std::printf("%7zu | move %8.1f %8.1f | glow %8.1f %8.1f | submit %8.1f %8.1f\n",
+      count, aosMove, soaMove, aosGlow, soaGlow, aosSubmit, soaSubmit);
+  }
+}
+
+int main()
+{
+  std::printf("millions of entities per second, AoS then SoA\n");
+  for (size_t count : { 1'000, 10'000, 100'000 })
+  {
+    Run(count);
+  }
+}
\ No newline at end of file
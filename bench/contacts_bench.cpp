@@ -0,0 +1,96 @@
+// contact callback throughput with 1,000 explosives resting on a platform. The field is first stepped at rest, where
+// the filter shader keeps PhysX from reporting anything. Then one bomb is dropped on the lava next to it, and the
+// field is stepped until the chain reaction is over, which is where contact reports and events come from
+
+#include <chrono>
+#include <functional>
+#include <cstdio>
+
+#include "physics_scene.h"
+
+namespace
+{
+  constexpr size_t BOMBS = 1000;
+  constexpr size_t REST_STEPS = 500;
+  constexpr size_t MAX_CHAIN_STEPS = 3000;
+
+  struct Phase
+  {
+    size_t steps{};
+    double seconds{};
+    Game::Physics::EventStats stats;
+  };
+
+  // steps until done() or maxSteps, whichever comes first
+  Phase Measure(Bench::HeadlessGame& game, size_t maxSteps, const std::function<bool()>& done)
+  {
+    using clock = std::chrono::steady_clock;
+    const auto before = game.physics.GetEventStats();
+    const auto start = clock::now();
+
+    Phase phase;
+    while (phase.steps < maxSteps && !done())
+    {
+      game.Step(1);
+      phase.steps++;
+    }
+
+    phase.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    const auto after = game.physics.GetEventStats();
+    phase.stats =
+    {
+      .contactPairs = after.contactPairs - before.contactPairs,
+      .events = after.events - before.events,
+      .processSeconds = after.processSeconds - before.processSeconds,
+    };
+    return phase;
+  }
+
+  void Print(const char* name, const Phase& phase)
+  {
+    const auto& stats = phase.stats;
+    std::printf("%-8s | %6zu %8.3f | %8llu %10.0f | %8llu %10.0f | %8.2f %8.3f\n", name,
+      phase.steps, phase.seconds * 1e3 / phase.steps,
+      static_cast<unsigned long long>(stats.contactPairs), stats.contactPairs / phase.seconds,
+      static_cast<unsigned long long>(stats.events), stats.events / phase.seconds,
+      stats.processSeconds * 1e6 / phase.steps, stats.events ? stats.processSeconds * 1e6 / stats.events : 0.0);
+  }
+
+  int Run()
+  {
+    Bench::HeadlessGame game(ThreadPool::DefaultThreadCount());
+    const Game::Level level = Bench::BombField(BOMBS);
+    game.world.LoadLevel(level, &game.physics);
+
+    const auto explosives = [&game] { return game.world.entityManager.Size(EntityType::EXPLOSIVE); };
+    const Phase rest = Measure(game, REST_STEPS, [] { return false; });
+    if (explosives() != BOMBS)
+    {
+      std::fprintf(stderr, "%zu of %zu bombs went off while resting\n", BOMBS - explosives(), BOMBS);
+      return 1;
+    }
+
+    game.world.MakeExplosive({ Bench::FieldEdge(level) + 2, EXPLOSIVE_SIZE + .5f, 0 }, &game.physics);
+    const Phase chain = Measure(game, MAX_CHAIN_STEPS, [&explosives] { return explosives() == 0; });
+
+    std::printf("%zu bombs, %zu workers besides the calling thread\n", BOMBS, game.workers.ThreadCount());
+    std::printf("%-8s | %6s %8s | %8s %10s | %8s %10s | %8s %8s\n", "phase",
+      "steps", "ms/step", "pairs", "pairs/s", "events", "events/s", "us/step", "us/event");
+    Print("resting", rest);
+    Print("chain", chain);
+    if (explosives() != 0)
+    {
+      std::printf("%zu bombs were left after %zu steps\n", explosives(), MAX_CHAIN_STEPS);
+    }
+    return 0;
+  }
+}
+
+int main()
+{
+  // nothing calls NewFrame, so the io the physics reads input from stays idle
+  ImGui::CreateContext();
+  const int result = Run();
+  ImGui::DestroyContext();
+  return result;
+}
\ No newline at end of file
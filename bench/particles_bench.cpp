@@ -0,0 +1,129 @@
+// particles per second through ParticleSystem::Update, with every block updated every tick so the LOD doesn't hide
+// any work. Runs with and without platforms to bounce off of, on the calling thread alone and with a worker pool.
+// Before timing, it emits into a full ring whose blocks are behind and checks that the live count still adds up
+
+#include <vector>
+#include <span>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "game/particles.h"
+#include "utility/thread_pool.h"
+#include "utility/random.h"
+
+namespace
+{
+  constexpr float DT = 0.01f;
+
+  // debris flying out of a few explosions spread over a 100x100 area
+  void Fill(Game::ParticleSystem& particles, size_t count, RandomStream& rng, float minLife, float maxLife)
+  {
+    std::vector<float> values(count * 5);
+    rng.Fill(values, 0.0f, 1.0f);
+    for (size_t i = 0; i < count; i++)
+    {
+      const float* r = &values[i * 5];
+      const glm::vec3 center(std::floor(r[0] * 8) * 12.5f, 5, std::floor(r[1] * 8) * 12.5f);
+      const glm::vec3 direction(r[2] - .5f, r[3], r[4] - .5f);
+      particles.Emit(
+        {
+          .position = center,
+          .velocity = direction * 20.0f,
+          .scale = 0.1f,
+          .life = minLife + (maxLife - minLife) * r[4],
+        });
+    }
+  }
+
+  size_t CountLive(const Game::ParticleSystem& particles)
+  {
+    size_t live = 0;
+    particles.ForEach([&live](glm::vec3, float) { live++; });
+    return live;
+  }
+
+  // emitting into a full ring recycles the oldest particles, whose blocks have skipped ticks and are caught up on
+  // the spot. Particles dying during that catch-up must only be counted once
+  bool CheckRecycling(ThreadPool& workers)
+  {
+    constexpr size_t capacity = 64 * 256;
+    Game::ParticleSystem particles(capacity, capacity);
+    RandomStream rng(1);
+    Fill(particles, capacity, rng, 0.0f, 0.05f);
+
+    // far away, so every block is only updated every MAX_STRIDE ticks
+    const Game::ParticleView far{ .eye = glm::vec3(1e6f) };
+    for (int tick = 0; tick < 3; tick++)
+    {
+      particles.Update(DT, far, workers);
+    }
+    Fill(particles, capacity / 2, rng, 1.0f, 2.0f);
+
+    if (particles.Size() != CountLive(particles))
+    {
+      std::fprintf(stderr, "live count is %zu, but %zu particles are alive\n", particles.Size(), CountLive(particles));
+      return false;
+    }
+    return true;
+  }
+
+  double Measure(size_t count, std::span<const Game::Aabb> colliders, ThreadPool& workers)
+  {
+    Game::ParticleSystem particles(count, count);
+    particles.lodNearDistance = 1e9f; // no LOD: every block, every tick
+    particles.SetColliders(colliders);
+    RandomStream rng(2);
+    Fill(particles, count, rng, 1e6f, 1e6f); // nothing dies while timing
+
+    const Game::ParticleView view{};
+    using clock = std::chrono::steady_clock;
+    particles.Update(DT, view, workers); // warm up caches
+    size_t ticks = 0;
+    const auto start = clock::now();
+    auto elapsed = clock::duration{};
+    do
+    {
+      particles.Update(DT, view, workers);
+      ticks++;
+      elapsed = clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(500));
+
+    if (particles.Size() != count)
+    {
+      std::fprintf(stderr, "expected %zu live particles, got %zu\n", count, particles.Size());
+      std::exit(1);
+    }
+    return count * ticks / std::chrono::duration<double>(elapsed).count();
+  }
+}
+
+int main()
+{
+  ThreadPool inline_(0);
+  ThreadPool workers(ThreadPool::DefaultThreadCount());
+  if (!CheckRecycling(inline_) || !CheckRecycling(workers))
+  {
+    return 1;
+  }
+
+  // a grid of platforms under the explosions
+  std::vector<Game::Aabb> platforms;
+  for (int z = 0; z < 8; z++)
+  {
+    for (int x = 0; x < 8; x++)
+    {
+      const glm::vec3 center(x * 12.5f, 0, z * 12.5f);
+      platforms.push_back({ center - glm::vec3(4, .5f, 4), center + glm::vec3(4, .5f, 4) });
+    }
+  }
+
+  std::printf("millions of particles per second (%zu workers besides the calling thread)\n", workers.ThreadCount());
+  std::printf("%9s | %12s %12s | %12s %12s\n", "particles", "1 thread", "pool", "1 thread+col", "pool+col");
+  for (size_t count : { 100'000, 200'000, 1'000'000 })
+  {
+    std::printf("%9zu | %12.1f %12.1f | %12.1f %12.1f\n", count,
+      Measure(count, {}, inline_) / 1e6, Measure(count, {}, workers) / 1e6,
+      Measure(count, platforms, inline_) / 1e6, Measure(count, platforms, workers) / 1e6);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+// headless setup shared by the PhysX benchmarks: the real World and Physics, driven without a window. Input is read
+// through an ImGuiIO that nothing ever writes to, so the player stands still and no keys are ever down
+
+#include <vector>
+#include <cmath>
+
+#include <glm/vec2.hpp>
+
+#include <imgui.h>
+
+#include "world.h"
+#include "game/level.h"
+#include "game/physics.h"
+#include "utility/thread_pool.h"
+
+namespace Bench
+{
+  constexpr float TICK = 0.01f; // one physics step per Simulate call
+
+  // count explosives sitting side by side on one platform, with the player and the win platform well out of reach.
+  // With more than one layer, the layers above the first are spawned a little apart and fall onto the ones below
+  inline Game::Level BombField(size_t count, size_t layers = 1)
+  {
+    Game::Level level;
+    level.name = "bomb field";
+
+    const size_t perLayer = (count + layers - 1) / layers;
+    const size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<float>(perLayer))));
+    const size_t rows = (perLayer + columns - 1) / columns;
+    const float spacing = EXPLOSIVE_SIZE * 2 + 0.1f;
+    const glm::vec2 size = glm::vec2(columns, rows) * spacing;
+    level.customPlatforms.push_back({ glm::vec3(0, 1, 0), glm::vec3(size.x / 2 + 1, 1, size.y / 2 + 1) });
+
+    // resting on the platform's top face
+    const glm::vec3 corner((spacing - size.x) / 2, 2 + EXPLOSIVE_SIZE, (spacing - size.y) / 2);
+    for (size_t i = 0; i < count; i++)
+    {
+      const size_t cell = i % perLayer;
+      const size_t layer = i / perLayer;
+      level.bombs.push_back(corner + glm::vec3(cell % columns, 0, cell / columns) * spacing + glm::vec3(0, layer * (spacing + 1), 0));
+    }
+
+    level.customPlatforms.push_back({ glm::vec3(200, 10, 0), SMALL_PLATFORM_SIZE });
+    level.startPos = { 200, 13, 0 };
+    level.winPlatformPos = { -200, 10, 0 };
+    level.winPlatformSize = SMALL_PLATFORM_SIZE;
+    return level;
+  }
+
+  // the edge of BombField's platform along x, where a bomb dropped just past it lands on the lava
+  inline float FieldEdge(const Game::Level& level)
+  {
+    return level.customPlatforms.front().second.x;
+  }
+
+  // one game's worth of state. Physics is declared last, so it's gone before the world it points to
+  struct HeadlessGame
+  {
+    ThreadPool workers;
+    World world;
+    Game::Physics physics;
+
+    explicit HeadlessGame(size_t threadCount)
+      : workers(threadCount),
+        physics(workers)
+    {
+      world.io = &ImGui::GetIO();
+      physics.SetWorld(&world);
+    }
+
+    NOCOPY_NOMOVE(HeadlessGame)
+
+    void Step(size_t steps)
+    {
+      for (size_t i = 0; i < steps; i++)
+      {
+        physics.Simulate(TICK);
+      }
+    }
+  };
+}
\ No newline at end of file
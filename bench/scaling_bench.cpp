@@ -0,0 +1,50 @@
+// how the physics step scales with the size of the worker pool PhysX runs on. Every run loads the same stress scene,
+// 2,000 explosives in four layers that fall onto each other, and times a fixed number of steps from the load. Runs go
+// from no workers, where everything is inline on the calling thread, to one worker per hardware thread
+
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "physics_scene.h"
+
+namespace
+{
+  constexpr size_t BOMBS = 2000;
+  constexpr size_t LAYERS = 4;
+  constexpr size_t STEPS = 500;
+
+  // seconds per step
+  double Measure(size_t workers, const Game::Level& level)
+  {
+    Bench::HeadlessGame game(workers);
+    game.world.LoadLevel(level, &game.physics);
+
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    game.Step(STEPS);
+    return std::chrono::duration<double>(clock::now() - start).count() / STEPS;
+  }
+}
+
+int main()
+{
+  // nothing calls NewFrame, so the io the physics reads input from stays idle
+  ImGui::CreateContext();
+
+  const Game::Level level = Bench::BombField(BOMBS, LAYERS);
+  const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+  std::printf("%zu bombs in %zu layers, %zu steps per run\n", BOMBS, LAYERS, STEPS);
+  std::printf("%7s | %8s %8s\n", "workers", "ms/step", "speedup");
+  const double inline_ = Measure(0, level);
+  std::printf("%7s | %8.3f %8.2f\n", "none", inline_ * 1e3, 1.0);
+  for (size_t workers = 1; workers <= cores; workers++)
+  {
+    const double seconds = Measure(workers, level);
+    std::printf("%7zu | %8.3f %8.2f\n", workers, seconds * 1e3, inline_ / seconds);
+  }
+
+  ImGui::DestroyContext();
+}
\ No newline at end of file
@@ -11,7 +11,8 @@ enum class EntityType
   REGULAR,
   TERRAIN,
   EXPLOSIVE,
-  PARTICLE,
+
+  COUNT
 };
 
 struct Transform
@@ -23,6 +24,21 @@ struct Transform
   glm::mat4 GetModel() const;
 };
 
+// pose before the last physics step that moved the entity, so rendering can blend from it to the current Transform
+// while waiting for the next step. step is the physics step that moved it
+struct PreviousPose
+{
+  glm::vec3 position{};
+  glm::quat rotation{ 1, 0, 0, 0 };
+  uint32_t step{};
+};
+
+// model matrix derived from Transform, only recomputed when the transform changes
+struct CachedModel
+{
+  glm::mat4 model{ 1.0f };
+};
+
 struct MeshHandle
 {
   uint32_t count{};
@@ -46,11 +62,4 @@ struct Renderable
 struct PhysicsFlags
 {
   bool isWinPlatform = false;
-};
-
-struct Particle
-{
-  float life{};
-  glm::vec3 velocity{};
-  glm::vec3 acceleration{};
 };
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+#include "utility/chunked_array.h"
+
+namespace Game
+{
+  // structure-of-arrays storage: each component type lives in its own chunked array, and element i of every array
+  // belongs to the same entity. Growing allocates new chunks instead of moving existing elements
+  template<typename... Ts>
+  class ComponentStorage
+  {
+  public:
+    template<typename T>
+    using Array = ChunkedArray<T>;
+
+    template<typename T>
+    Array<T>& Get() { return std::get<Array<T>>(arrays_); }
+
+    template<typename T>
+    const Array<T>& Get() const { return std::get<Array<T>>(arrays_); }
+
+    size_t Size() const { return std::get<0>(arrays_).size(); }
+
+    // calls fn(count, Us*...) for every chunk, with one pointer per requested array
+    template<typename... Us, typename Fn>
+    void ForEachChunk(Fn&& fn)
+    {
+      auto& first = std::get<0>(arrays_);
+      for (size_t c = 0; c < first.chunk_count(); c++)
+      {
+        const size_t count = std::min(first.chunk_size, first.size() - c * first.chunk_size);
+        fn(count, Get<Us>().chunk_data(c)...);
+      }
+    }
+
+    // same as above, but chunks are visited according to an execution policy or a ThreadPool
+    template<typename... Us, typename ExecutionPolicy, typename Fn>
+    void ForEachChunk(ExecutionPolicy&& policy, Fn&& fn)
+    {
+      std::get<0>(arrays_).for_each_chunk(policy, [this, &fn](const auto*, size_t first, size_t count)
+        {
+          const size_t c = first / std::get<0>(arrays_).chunk_size;
+          fn(count, Get<Us>().chunk_data(c)...);
+        });
+    }
+
+    void PushBack(const Ts&... values)
+    {
+      (Get<Ts>().push_back(values), ...);
+    }
+
+    // appends count copies of the given values
+    void Append(size_t count, const Ts&... values)
+    {
+      (Get<Ts>().append(count, values), ...);
+    }
+
+    // moves the last element into index and shrinks every array by one
+    void SwapRemove(size_t index)
+    {
+      (SwapRemoveOne(Get<Ts>(), index), ...);
+    }
+
+    void Reserve(size_t count)
+    {
+      (Get<Ts>().reserve(count), ...);
+    }
+
+    void Clear()
+    {
+      (Get<Ts>().clear(), ...);
+    }
+
+    // copies every array of other into this storage without giving up already allocated chunks
+    void Assign(const ComponentStorage& other)
+    {
+      (Get<Ts>().assign(other.Get<Ts>()), ...);
+    }
+
+  private:
+    template<typename T>
+    static void SwapRemoveOne(Array<T>& array, size_t index)
+    {
+      array[index] = std::move(array.back());
+      array.pop_back();
+    }
+
+    std::tuple<Array<Ts>...> arrays_;
+  };
+}
\ No newline at end of file
@@ -1,49 +1,305 @@
 #include "game.h"
 
+#include <algorithm>
+
 namespace Game
 {
-  entity_t EntityManager::CreateEntity()
+  EntityManager::EntityManager()
   {
-    GameObject obj{};
-    obj.entity = ++nextEntity;
-    obj.type = EntityType::REGULAR;
-    objects.push_back(obj);
-    return nextEntity;
+    sparse.reserve(4096);
+    versions.reserve(4096);
+    freeList.reserve(4096);
+    pendingCreates.reserve(4096);
+    pendingDestroys.reserve(4096);
+    for (size_t t = 0; t < buckets.size(); t++)
+    {
+      Reserve(EntityType(t), 1024);
+    }
   }
 
-  GameObject& EntityManager::GetObject(entity_t entity)
+  entity_t EntityManager::CreateEntity(EntityType type)
   {
-    for (size_t i = 0; i < objects.size(); i++)
+    uint32_t index;
+    if (!freeList.empty())
     {
-      if (objects[i].entity == entity)
+      index = freeList.back();
+      freeList.pop_back();
+    }
+    else
+    {
+      index = nextEntity++;
+      if (index >= sparse.size())
       {
-        return objects[i];
+        sparse.push_back({});
+        versions.push_back(1);
       }
     }
 
-    assert(0 && "Tried to retrieve object that didn't exist!");
-    return objects.front();
+    auto& bucket = buckets[size_t(type)];
+    const entity_t entity{ index, versions[index] };
+    sparse[index] = { static_cast<uint32_t>(bucket.Size()), type };
+    bucket.PushBack(entity, Transform{}, MeshHandle{}, Renderable{}, PhysicsFlags{},
+      Changed<Transform>{ currentTick }, CachedModel{}, PreviousPose{});
+    return entity;
   }
 
-  void EntityManager::DestroyEntity(entity_t entity)
+  entity_t EntityManager::Spawn(const Prefab& prefab)
   {
-    for (size_t i = 0; i < objects.size(); i++)
+    const uint32_t dense = SpawnBatch(prefab, 1);
+    return buckets[size_t(prefab.type)].Get<entity_t>()[dense];
+  }
+
+  uint32_t EntityManager::SpawnBatch(const Prefab& prefab, size_t count)
+  {
+    auto& bucket = buckets[size_t(prefab.type)];
+    const uint32_t first = static_cast<uint32_t>(bucket.Size());
+    bucket.Append(count, null_entity, prefab.transform, prefab.mesh, prefab.renderable, prefab.physics,
+      Changed<Transform>{ currentTick }, CachedModel{}, PreviousPose{});
+
+    // grow the sparse table once for the slots that can't be recycled
+    const size_t fresh = count > freeList.size() ? count - freeList.size() : 0;
+    if (nextEntity + fresh > sparse.size())
+    {
+      sparse.resize(nextEntity + fresh);
+      versions.resize(nextEntity + fresh, 1);
+    }
+
+    auto& entities = bucket.Get<entity_t>();
+    for (uint32_t i = 0; i < count; i++)
     {
-      if (objects[i].entity == entity)
+      uint32_t index;
+      if (!freeList.empty())
       {
-        //printf("Destroyed object %d\n", objects[i]->entity);
-        objects[i] = std::move(objects.back());
-        objects.pop_back();
-        return;
+        index = freeList.back();
+        freeList.pop_back();
       }
+      else
+      {
+        index = nextEntity++;
+      }
+
+      entities[first + i] = { index, versions[index] };
+      sparse[index] = { first + i, prefab.type };
+    }
+
+    return first;
+  }
+
+  GameObject EntityManager::GetObject(entity_t entity)
+  {
+    assert(IsAlive(entity) && "Tried to retrieve object that didn't exist!");
+    return MakeView(sparse[entity.index]);
+  }
+
+  std::optional<GameObject> EntityManager::TryGetObject(entity_t entity)
+  {
+    if (!IsAlive(entity))
+    {
+      return std::nullopt;
     }
 
-    assert(0 && "Tried to delete an object that didn't exist!");
+    return MakeView(sparse[entity.index]);
+  }
+
+  bool EntityManager::IsAlive(entity_t entity) const
+  {
+    return entity.index < nextEntity &&
+      versions[entity.index] == entity.version &&
+      sparse[entity.index].dense != invalid_index;
+  }
+
+  void EntityManager::DestroyEntity(entity_t entity)
+  {
+    if (!IsAlive(entity))
+    {
+      assert(0 && "Tried to delete an object that didn't exist!");
+      return;
+    }
+
+    // swap the last entity of the bucket into the hole and patch its sparse entry
+    const auto [dense, type] = sparse[entity.index];
+    auto& bucket = buckets[size_t(type)];
+    bucket.SwapRemove(dense);
+    if (dense < bucket.Size())
+    {
+      sparse[bucket.Get<entity_t>()[dense].index].dense = dense;
+    }
+
+    sparse[entity.index] = {};
+    if (++versions[entity.index] == 0)
+    {
+      versions[entity.index] = 1;
+    }
+    freeList.push_back(entity.index);
   }
 
   void EntityManager::Clear()
   {
-    objects.clear();
+    // indices restart from zero, but versions keep counting up so handles from before the clear stay stale
+    for (auto& bucket : buckets)
+    {
+      for (entity_t entity : bucket.Get<entity_t>())
+      {
+        if (++versions[entity.index] == 0)
+        {
+          versions[entity.index] = 1;
+        }
+      }
+      bucket.Clear();
+    }
+
+    std::fill(sparse.begin(), sparse.end(), Location{});
+    freeList.clear();
     nextEntity = 0;
+
+    std::scoped_lock lock(commandMutex);
+    pendingCreates.clear();
+    pendingDestroys.clear();
+  }
+
+  void EntityManager::SaveSnapshot(Snapshot& snapshot) const
+  {
+    // versions don't need to be saved, the handles stored in the buckets carry them
+    snapshot.nextEntity = nextEntity;
+    snapshot.sparse.assign(sparse.begin(), sparse.begin() + nextEntity);
+    snapshot.freeList = freeList;
+    for (size_t t = 0; t < buckets.size(); t++)
+    {
+      snapshot.buckets[t].Assign(buckets[t]);
+    }
+  }
+
+  void EntityManager::LoadSnapshot(const Snapshot& snapshot)
+  {
+    // invalidate every current handle first, then give the saved entities versions past anything handed out so far.
+    // Restoring old versions would let a handle created since the save become valid again once its slot is reused
+    for (auto& bucket : buckets)
+    {
+      for (entity_t entity : bucket.Get<entity_t>())
+      {
+        if (++versions[entity.index] == 0)
+        {
+          versions[entity.index] = 1;
+        }
+      }
+    }
+
+    // the sparse table never shrinks, so it's at least as big as when the snapshot was saved
+    assert(snapshot.sparse.size() <= sparse.size());
+    std::fill(sparse.begin(), sparse.end(), Location{});
+    std::copy(snapshot.sparse.begin(), snapshot.sparse.end(), sparse.begin());
+    freeList = snapshot.freeList;
+    nextEntity = snapshot.nextEntity;
+
+    for (size_t t = 0; t < buckets.size(); t++)
+    {
+      auto& bucket = buckets[t];
+      bucket.Assign(snapshot.buckets[t]);
+      for (entity_t& entity : bucket.Get<entity_t>())
+      {
+        if (++versions[entity.index] == 0)
+        {
+          versions[entity.index] = 1;
+        }
+        entity.version = versions[entity.index];
+      }
+
+      // every restored transform counts as a change
+      auto& changed = bucket.Get<Changed<Transform>>();
+      std::fill(changed.begin(), changed.end(), Changed<Transform>{ currentTick });
+    }
+
+    std::scoped_lock lock(commandMutex);
+    pendingCreates.clear();
+    pendingDestroys.clear();
+  }
+
+  void EntityManager::Reserve(EntityType type, size_t count)
+  {
+    buckets[size_t(type)].Reserve(count);
+  }
+
+  size_t EntityManager::Size() const
+  {
+    size_t size = 0;
+    for (const auto& bucket : buckets)
+    {
+      size += bucket.Size();
+    }
+    return size;
+  }
+
+  void EntityManager::DeferCreate(const Prefab& prefab)
+  {
+    std::scoped_lock lock(commandMutex);
+    pendingCreates.push_back(prefab);
+  }
+
+  void EntityManager::DeferDestroy(entity_t entity)
+  {
+    std::scoped_lock lock(commandMutex);
+    pendingDestroys.push_back(entity);
+  }
+
+  void EntityManager::FlushCommands()
+  {
+    std::scoped_lock lock(commandMutex);
+
+    // the same entity may have been queued more than once, so drop stale handles before sorting
+    std::erase_if(pendingDestroys, [this](entity_t e) { return !IsAlive(e); });
+
+    // destroy from the back of each bucket first, so a swap-remove never moves another pending entity
+    std::sort(pendingDestroys.begin(), pendingDestroys.end(), [this](entity_t a, entity_t b)
+      {
+        const auto& la = sparse[a.index];
+        const auto& lb = sparse[b.index];
+        return la.type != lb.type ? la.type < lb.type : la.dense > lb.dense;
+      });
+    for (entity_t entity : pendingDestroys)
+    {
+      if (IsAlive(entity))
+      {
+        DestroyEntity(entity);
+      }
+    }
+
+    // one SpawnBatch per type grows and fills each of its arrays once, then every entity gets its own prefab's values.
+    // The sort is stable so entities are created in the order they were queued
+    std::stable_sort(pendingCreates.begin(), pendingCreates.end(), [](const Prefab& a, const Prefab& b)
+      {
+        return a.type < b.type;
+      });
+    for (auto run = pendingCreates.begin(); run != pendingCreates.end();)
+    {
+      const auto end = std::find_if(run, pendingCreates.end(), [type = run->type](const Prefab& p) { return p.type != type; });
+      SpawnBatch(*run, static_cast<size_t>(end - run), [run](size_t i, GameObject object)
+        {
+          const Prefab& prefab = run[i];
+          object.transform = prefab.transform;
+          object.mesh = prefab.mesh;
+          object.renderable = prefab.renderable;
+          object.physics = prefab.physics;
+        });
+      run = end;
+    }
+
+    // clear() keeps the capacity, so recording commands next tick doesn't allocate
+    pendingCreates.clear();
+    pendingDestroys.clear();
+  }
+
+  GameObject EntityManager::MakeView(Location location)
+  {
+    auto& bucket = buckets[size_t(location.type)];
+    const uint32_t dense = location.dense;
+    return
+    {
+      .entity = bucket.Get<entity_t>()[dense],
+      .type = location.type,
+      .transform = bucket.Get<Transform>()[dense],
+      .mesh = bucket.Get<MeshHandle>()[dense],
+      .renderable = bucket.Get<Renderable>()[dense],
+      .physics = bucket.Get<PhysicsFlags>()[dense],
+    };
   }
 }
\ No newline at end of file
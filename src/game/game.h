@@ -1,45 +1,276 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <functional>
+#include <optional>
+#include <mutex>
+#include <concepts>
 
 #include "macros.h"
 #include "components.h"
+#include "component_storage.h"
 #include "gfx/renderer.h"
 
 namespace Game
 {
-  using entity_t = int32_t;
-  constexpr entity_t null_entity = 0;
+  // generational handle: index addresses a slot in the sparse table, version is bumped every time that slot is freed
+  struct entity_t
+  {
+    uint32_t index{};
+    uint32_t version{}; // 0 is never handed out, so a zeroed handle is the null entity
+
+    explicit operator bool() const { return version != 0; }
+    bool operator==(const entity_t&) const = default;
+  };
+
+  constexpr entity_t null_entity{};
+
+  // tick on which a component of type T was last written, so consumers can skip entities that haven't changed
+  template<typename T>
+  struct Changed
+  {
+    uint32_t tick{};
+  };
+
+  template<typename T>
+  constexpr uint32_t ComponentBit()
+  {
+    if constexpr (std::same_as<T, entity_t>) return 1 << 0;
+    else if constexpr (std::same_as<T, Transform>) return 1 << 1;
+    else if constexpr (std::same_as<T, MeshHandle>) return 1 << 2;
+    else if constexpr (std::same_as<T, Renderable>) return 1 << 3;
+    else if constexpr (std::same_as<T, PhysicsFlags>) return 1 << 4;
+    else if constexpr (std::same_as<T, Changed<Transform>>) return 1 << 5;
+    else if constexpr (std::same_as<T, CachedModel>) return 1 << 6;
+    else if constexpr (std::same_as<T, PreviousPose>) return 1 << 7;
+    else static_assert(!sizeof(T), "Not a component type");
+  }
+
+  // the components that are meaningful for each type of entity, used to pick which buckets a query visits
+  constexpr uint32_t ComponentSignature(EntityType type)
+  {
+    constexpr uint32_t base = ComponentBit<entity_t>() | ComponentBit<Transform>() | ComponentBit<MeshHandle>() | ComponentBit<Renderable>() |
+      ComponentBit<Changed<Transform>>() | ComponentBit<CachedModel>() | ComponentBit<PreviousPose>();
+    switch (type)
+    {
+    case EntityType::TERRAIN:
+    case EntityType::EXPLOSIVE: return base | ComponentBit<PhysicsFlags>();
+    default: return base;
+    }
+  }
 
+  template<typename... Ts>
+  constexpr bool HasComponents(EntityType type)
+  {
+    return ((ComponentSignature(type) & ComponentBit<Ts>()) && ...);
+  }
+
+  // view of one entity's components, which live in separate arrays inside the EntityManager
+  // creating entities never invalidates it, but destroying any entity may move another one into the freed slot
   struct GameObject
   {
-    entity_t entity{};
+    entity_t entity;
 
+    const EntityType type;
+    Transform& transform;
+    MeshHandle& mesh;
+    Renderable& renderable;
+    PhysicsFlags& physics;
+  };
+
+  // template of initial component values that entities are stamped out from
+  struct Prefab
+  {
     EntityType type = EntityType::REGULAR;
     Transform transform{};
     MeshHandle mesh{};
     Renderable renderable{};
     PhysicsFlags physics{};
-    Particle particle{};
   };
 
   class EntityManager
   {
   public:
-    EntityManager() {};
+    EntityManager();
     ~EntityManager() {};
 
     NOCOPY_NOMOVE(EntityManager)
 
-    entity_t CreateEntity();
-    GameObject& GetObject(entity_t entity);
-    auto& GetObjects() { return objects; }
+    entity_t CreateEntity(EntityType type = EntityType::REGULAR);
+    entity_t Spawn(const Prefab& prefab);
+
+    // creates count copies of prefab with a single growth check per array, then calls fn(i, GameObject) on each
+    // new entity so per-instance values can be overridden
+    template<typename Fn>
+    void SpawnBatch(const Prefab& prefab, size_t count, Fn&& fn)
+    {
+      const uint32_t first = SpawnBatch(prefab, count);
+      for (size_t i = 0; i < count; i++)
+      {
+        fn(i, MakeView({ static_cast<uint32_t>(first + i), prefab.type }));
+      }
+    }
+
+    // returns the dense index of the first new entity within the prefab type's bucket
+    uint32_t SpawnBatch(const Prefab& prefab, size_t count);
+    GameObject GetObject(entity_t entity);
+    std::optional<GameObject> TryGetObject(entity_t entity);
+    bool IsAlive(entity_t entity) const;
     void DestroyEntity(entity_t entity);
     void Clear();
+    void Reserve(EntityType type, size_t count);
+
+    // snapshots copy the whole entity state so it can be brought back in place, e.g. to restart a level.
+    // Versions only ever go up, so loading gives the restored entities new versions and every handle from before the
+    // load is stale. Anything that kept handles from the save gets the restored entities' handles from Restamp()
+    class Snapshot;
+    void SaveSnapshot(Snapshot& snapshot) const;
+    void LoadSnapshot(const Snapshot& snapshot);
+
+    // handle of the restored entity that saved referred to when the snapshot was saved. Only meant for handles that
+    // were alive at the save, right after loading it
+    entity_t Restamp(entity_t saved) const
+    {
+      const entity_t entity{ saved.index, versions[saved.index] };
+      assert(IsAlive(entity));
+      return entity;
+    }
+
+    // deferred commands can be recorded from any thread while entities are being iterated,
+    // and are applied in one batch by FlushCommands() after every physics tick
+    void DeferCreate(const Prefab& prefab);
+    void DeferDestroy(entity_t entity);
+    void FlushCommands();
+
+    size_t Size() const;
+    size_t Size(EntityType type) const { return buckets[size_t(type)].Size(); }
+
+    // change tracking: anything that writes a tracked component stamps it with the current tick, and consumers
+    // remember the last tick they saw. Spawning an entity counts as a change
+    uint32_t CurrentTick() const { return currentTick; }
+    void EndFrame() { currentTick++; }
+
+    template<typename T>
+    void MarkChanged(entity_t entity)
+    {
+      assert(IsAlive(entity));
+      const auto [dense, type] = sparse[entity.index];
+      buckets[size_t(type)].Get<Changed<T>>()[dense].tick = currentTick;
+    }
+
+    // direct access to one component of an entity, without building a whole GameObject
+    template<typename T>
+    T& Get(entity_t entity)
+    {
+      assert(IsAlive(entity));
+      const auto [dense, type] = sparse[entity.index];
+      return buckets[size_t(type)].Get<T>()[dense];
+    }
+
+    // returns a tracked component of an entity for writing and marks it as changed, with a single lookup
+    template<typename T>
+    T& Write(entity_t entity)
+    {
+      assert(IsAlive(entity));
+      const auto [dense, type] = sparse[entity.index];
+      auto& bucket = buckets[size_t(type)];
+      bucket.Get<Changed<T>>()[dense].tick = currentTick;
+      return bucket.Get<T>()[dense];
+    }
+
+    // typed queries: Each<Transform, PhysicsFlags>(fn) calls fn(Transform&, PhysicsFlags&) for every entity whose type has
+    // all the requested components. Only matching buckets are visited, so cost scales with the number of matches
+    template<typename... Ts, typename Fn>
+    void Each(Fn&& fn)
+    {
+      for (size_t t = 0; t < buckets.size(); t++)
+      {
+        if (HasComponents<Ts...>(EntityType(t)))
+        {
+          EachInBucket<Ts...>(buckets[t], fn);
+        }
+      }
+    }
+
+    // same as above, restricted to one type of entity
+    template<typename... Ts, typename Fn>
+    void Each(EntityType type, Fn&& fn)
+    {
+      assert(HasComponents<Ts...>(type));
+      EachInBucket<Ts...>(buckets[size_t(type)], fn);
+    }
+
+    // chunk-level query: calls fn(count, Ts*...) for contiguous runs of matching entities, using an execution policy
+    // or a ThreadPool
+    template<typename... Ts, typename ExecutionPolicy, typename Fn>
+    void EachChunk(ExecutionPolicy&& policy, Fn&& fn)
+    {
+      for (size_t t = 0; t < buckets.size(); t++)
+      {
+        if (HasComponents<Ts...>(EntityType(t)))
+        {
+          buckets[t].template ForEachChunk<Ts...>(policy, fn);
+        }
+      }
+    }
 
   private:
-    entity_t nextEntity = 0;
+    static constexpr uint32_t invalid_index = ~0u;
+
+    // every type of entity gets its own bucket of component arrays
+    using Bucket = ComponentStorage<entity_t, Transform, MeshHandle, Renderable, PhysicsFlags,
+      Changed<Transform>, CachedModel, PreviousPose>;
+
+    struct Location
+    {
+      uint32_t dense = invalid_index; // index into the bucket's component arrays
+      EntityType type{};
+    };
+
+    template<typename... Ts, typename Fn>
+    static void EachInBucket(Bucket& bucket, Fn& fn)
+    {
+      bucket.ForEachChunk<Ts...>([&fn](size_t count, Ts*... arrays)
+        {
+          for (size_t i = 0; i < count; i++)
+          {
+            fn(arrays[i]...);
+          }
+        });
+    }
 
-    std::vector<GameObject> objects;
+    uint32_t nextEntity = 0; // next never-used slot in the sparse table
+    uint32_t currentTick = 1; // starts above zero so that a consumer that has seen nothing yet sees every entity as changed
+
+    std::vector<Location> sparse;   // entity index -> location of its components
+    std::vector<uint32_t> versions; // entity index -> current version of that slot
+    std::vector<uint32_t> freeList; // recycled entity indices
+    std::array<Bucket, size_t(EntityType::COUNT)> buckets;
+
+    std::mutex commandMutex;
+    std::vector<Prefab> pendingCreates;
+    std::vector<entity_t> pendingDestroys;
+
+    GameObject MakeView(Location location);
+  };
+
+  class EntityManager::Snapshot
+  {
+    friend class EntityManager;
+
+    uint32_t nextEntity = 0;
+    std::vector<Location> sparse;
+    std::vector<uint32_t> freeList;
+    std::array<Bucket, size_t(EntityType::COUNT)> buckets;
   };
-}
\ No newline at end of file
+}
+
+template<>
+struct std::hash<Game::entity_t>
+{
+  size_t operator()(const Game::entity_t& e) const noexcept
+  {
+    return std::hash<uint64_t>{}(uint64_t(e.version) << 32 | e.index);
+  }
+};
\ No newline at end of file
@@ -0,0 +1,585 @@
+#include "particles.h"
+#include "utility/thread_pool.h"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+
+// the widest instruction set enabled for this build is picked at compile time (/arch:AVX2 or -mavx2 for the AVX2 path)
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define PARTICLES_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define PARTICLES_SSE 1
+#endif
+
+namespace
+{
+  // advances particles with the coefficients of a ParticleSystem::Step
+  struct Kernel
+  {
+    float* px, * py, * pz;
+    float* vx, * vy, * vz;
+    float* life;
+    float velocityScale;
+    glm::vec3 dv;
+    float positionScale;
+    glm::vec3 dp;
+    float lifeStep;
+  };
+
+  // integrates particles [first, last) and returns the number of them whose life dropped below zero in this step
+  size_t IntegrateScalar(const Kernel& k, size_t first, size_t last)
+  {
+    size_t dead = 0;
+    for (size_t i = first; i < last; i++)
+    {
+      const glm::vec3 v(k.vx[i], k.vy[i], k.vz[i]);
+      k.px[i] += v.x * k.positionScale + k.dp.x;
+      k.py[i] += v.y * k.positionScale + k.dp.y;
+      k.pz[i] += v.z * k.positionScale + k.dp.z;
+      k.vx[i] = v.x * k.velocityScale + k.dv.x;
+      k.vy[i] = v.y * k.velocityScale + k.dv.y;
+      k.vz[i] = v.z * k.velocityScale + k.dv.z;
+      const float life = k.life[i];
+      k.life[i] = life - k.lifeStep;
+      dead += life >= 0 && k.life[i] < 0;
+    }
+    return dead;
+  }
+
+#if PARTICLES_AVX2
+  size_t Integrate(const Kernel& k, size_t first, size_t last)
+  {
+    const __m256 vs = _mm256_set1_ps(k.velocityScale);
+    const __m256 ps = _mm256_set1_ps(k.positionScale);
+    const __m256 dvx = _mm256_set1_ps(k.dv.x), dvy = _mm256_set1_ps(k.dv.y), dvz = _mm256_set1_ps(k.dv.z);
+    const __m256 dpx = _mm256_set1_ps(k.dp.x), dpy = _mm256_set1_ps(k.dp.y), dpz = _mm256_set1_ps(k.dp.z);
+    const __m256 lifeStep = _mm256_set1_ps(k.lifeStep);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t dead = 0;
+    size_t i = first;
+    for (; i + 8 <= last; i += 8)
+    {
+      const __m256 vx = _mm256_loadu_ps(k.vx + i);
+      const __m256 vy = _mm256_loadu_ps(k.vy + i);
+      const __m256 vz = _mm256_loadu_ps(k.vz + i);
+      _mm256_storeu_ps(k.px + i, _mm256_add_ps(_mm256_loadu_ps(k.px + i), _mm256_add_ps(_mm256_mul_ps(vx, ps), dpx)));
+      _mm256_storeu_ps(k.py + i, _mm256_add_ps(_mm256_loadu_ps(k.py + i), _mm256_add_ps(_mm256_mul_ps(vy, ps), dpy)));
+      _mm256_storeu_ps(k.pz + i, _mm256_add_ps(_mm256_loadu_ps(k.pz + i), _mm256_add_ps(_mm256_mul_ps(vz, ps), dpz)));
+      _mm256_storeu_ps(k.vx + i, _mm256_add_ps(_mm256_mul_ps(vx, vs), dvx));
+      _mm256_storeu_ps(k.vy + i, _mm256_add_ps(_mm256_mul_ps(vy, vs), dvy));
+      _mm256_storeu_ps(k.vz + i, _mm256_add_ps(_mm256_mul_ps(vz, vs), dvz));
+
+      const __m256 lifeOld = _mm256_loadu_ps(k.life + i);
+      const __m256 life = _mm256_sub_ps(lifeOld, lifeStep);
+      _mm256_storeu_ps(k.life + i, life);
+      const __m256 died = _mm256_andnot_ps(_mm256_cmp_ps(lifeOld, zero, _CMP_LT_OQ), _mm256_cmp_ps(life, zero, _CMP_LT_OQ));
+      dead += std::popcount(static_cast<unsigned>(_mm256_movemask_ps(died)));
+    }
+
+    return dead + IntegrateScalar(k, i, last);
+  }
+#elif PARTICLES_SSE
+  size_t Integrate(const Kernel& k, size_t first, size_t last)
+  {
+    const __m128 vs = _mm_set1_ps(k.velocityScale);
+    const __m128 ps = _mm_set1_ps(k.positionScale);
+    const __m128 dvx = _mm_set1_ps(k.dv.x), dvy = _mm_set1_ps(k.dv.y), dvz = _mm_set1_ps(k.dv.z);
+    const __m128 dpx = _mm_set1_ps(k.dp.x), dpy = _mm_set1_ps(k.dp.y), dpz = _mm_set1_ps(k.dp.z);
+    const __m128 lifeStep = _mm_set1_ps(k.lifeStep);
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t dead = 0;
+    size_t i = first;
+    for (; i + 4 <= last; i += 4)
+    {
+      const __m128 vx = _mm_loadu_ps(k.vx + i);
+      const __m128 vy = _mm_loadu_ps(k.vy + i);
+      const __m128 vz = _mm_loadu_ps(k.vz + i);
+      _mm_storeu_ps(k.px + i, _mm_add_ps(_mm_loadu_ps(k.px + i), _mm_add_ps(_mm_mul_ps(vx, ps), dpx)));
+      _mm_storeu_ps(k.py + i, _mm_add_ps(_mm_loadu_ps(k.py + i), _mm_add_ps(_mm_mul_ps(vy, ps), dpy)));
+      _mm_storeu_ps(k.pz + i, _mm_add_ps(_mm_loadu_ps(k.pz + i), _mm_add_ps(_mm_mul_ps(vz, ps), dpz)));
+      _mm_storeu_ps(k.vx + i, _mm_add_ps(_mm_mul_ps(vx, vs), dvx));
+      _mm_storeu_ps(k.vy + i, _mm_add_ps(_mm_mul_ps(vy, vs), dvy));
+      _mm_storeu_ps(k.vz + i, _mm_add_ps(_mm_mul_ps(vz, vs), dvz));
+
+      const __m128 lifeOld = _mm_loadu_ps(k.life + i);
+      const __m128 life = _mm_sub_ps(lifeOld, lifeStep);
+      _mm_storeu_ps(k.life + i, life);
+      const __m128 died = _mm_andnot_ps(_mm_cmplt_ps(lifeOld, zero), _mm_cmplt_ps(life, zero));
+      dead += std::popcount(static_cast<unsigned>(_mm_movemask_ps(died)));
+    }
+
+    return dead + IntegrateScalar(k, i, last);
+  }
+#else
+  size_t Integrate(const Kernel& k, size_t first, size_t last)
+  {
+    return IntegrateScalar(k, first, last);
+  }
+#endif
+
+  // boxes are inserted into every cell they overlap after growing them by this much, which has to cover the biggest
+  // particle radius plus the distance a particle can travel in the longest step (2 * MAX_STRIDE - 1 ticks),
+  // so only the cell a particle ends up in needs to be searched
+  constexpr float COLLIDER_MARGIN = 6.0f;
+  constexpr float COLLIDER_CELL_SIZE = 4.0f;
+  constexpr uint32_t COLLIDER_MAX_CELLS_PER_AXIS = 256;
+
+  struct BoxArrays
+  {
+    const float* minX, * minY, * minZ;
+    const float* maxX, * maxY, * maxZ;
+  };
+
+  struct Hit
+  {
+    size_t box;
+    float t;
+  };
+
+  // slab test of the segment p0 + t * d, t in [0, 1] against the boxes [first, last) grown by radius.
+  // Returns the index of the first box hit and the time of entry, or last if nothing was hit.
+  // Segments starting inside a box are ignored, so a particle can't get stuck in one
+#if PARTICLES_AVX2 || PARTICLES_SSE
+  // four boxes per iteration, the box arrays are padded so [first, last) is always a multiple of 4
+  Hit FindHit(const BoxArrays& boxes, size_t first, size_t last, glm::vec3 p0, glm::vec3 invD, float radius)
+  {
+    const __m128 r = _mm_set1_ps(radius);
+    const __m128 px = _mm_set1_ps(p0.x), py = _mm_set1_ps(p0.y), pz = _mm_set1_ps(p0.z);
+    const __m128 ix = _mm_set1_ps(invD.x), iy = _mm_set1_ps(invD.y), iz = _mm_set1_ps(invD.z);
+    const __m128 zero = _mm_setzero_ps();
+
+    Hit hit{ last, 1.0f };
+    for (size_t b = first; b < last; b += 4)
+    {
+      const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minX + b), r), px), ix);
+      const __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxX + b), r), px), ix);
+      const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minY + b), r), py), iy);
+      const __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxY + b), r), py), iy);
+      const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minZ + b), r), pz), iz);
+      const __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxZ + b), r), pz), iz);
+      const __m128 tMin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx1, tx2), _mm_min_ps(ty1, ty2)), _mm_min_ps(tz1, tz2));
+      const __m128 tMax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx1, tx2), _mm_max_ps(ty1, ty2)), _mm_max_ps(tz1, tz2));
+      const __m128 hitMask = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(tMin, tMax), _mm_cmpge_ps(tMin, zero)),
+        _mm_cmple_ps(tMin, _mm_set1_ps(hit.t)));
+
+      int mask = _mm_movemask_ps(hitMask);
+      if (mask == 0)
+      {
+        continue;
+      }
+
+      alignas(16) float t[4];
+      _mm_store_ps(t, tMin);
+      for (; mask != 0; mask &= mask - 1)
+      {
+        const int lane = std::countr_zero(static_cast<unsigned>(mask));
+        if (t[lane] <= hit.t)
+        {
+          hit = { b + lane, t[lane] };
+        }
+      }
+    }
+    return hit;
+  }
+#else
+  Hit FindHit(const BoxArrays& boxes, size_t first, size_t last, glm::vec3 p0, glm::vec3 invD, float radius)
+  {
+    Hit hit{ last, 1.0f };
+    for (size_t b = first; b < last; b++)
+    {
+      const float tx1 = (boxes.minX[b] - radius - p0.x) * invD.x;
+      const float tx2 = (boxes.maxX[b] + radius - p0.x) * invD.x;
+      const float ty1 = (boxes.minY[b] - radius - p0.y) * invD.y;
+      const float ty2 = (boxes.maxY[b] + radius - p0.y) * invD.y;
+      const float tz1 = (boxes.minZ[b] - radius - p0.z) * invD.z;
+      const float tz2 = (boxes.maxZ[b] + radius - p0.z) * invD.z;
+      const float tMin = std::max({ std::min(tx1, tx2), std::min(ty1, ty2), std::min(tz1, tz2) });
+      const float tMax = std::min({ std::max(tx1, tx2), std::max(ty1, ty2), std::max(tz1, tz2) });
+      if (tMin <= tMax && tMin >= 0 && tMin <= hit.t)
+      {
+        hit = { b, tMin };
+      }
+    }
+    return hit;
+  }
+#endif
+}
+
+namespace Game
+{
+  ParticleSystem::ParticleSystem(size_t capacity, size_t emitBudgetPerTick)
+    : capacity_((capacity + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE), emitBudgetPerTick_(emitBudgetPerTick), budget_(emitBudgetPerTick)
+  {
+    assert(capacity > 0);
+    for (auto* array : { &px_, &py_, &pz_, &vx_, &vy_, &vz_, &scale_ })
+    {
+      array->resize(capacity_);
+    }
+    life_.resize(capacity_, -1.0f);
+    blockTick_.resize(capacity_ / BLOCK_SIZE);
+  }
+
+  bool ParticleSystem::Emit(const ParticleDesc& desc)
+  {
+    if (budget_ == 0)
+    {
+      return false;
+    }
+    budget_--;
+
+    // recycle the oldest particle when full. It's killed here so catching up its block below can't count it again
+    if (count_ == capacity_)
+    {
+      alive_ -= life_[head_] >= 0;
+      life_[head_] = -1.0f;
+      head_ = Next(head_);
+      count_--;
+    }
+
+    // the rest of the block may be behind, bring it up to date so the new particle doesn't get simulated in the past
+    const size_t i = (head_ + count_) % capacity_;
+    SyncBlock(i / BLOCK_SIZE);
+    assert(life_[i] < 0 && "slots outside of the live range must be dead");
+    assert(alive_ <= count_);
+
+    px_[i] = desc.position.x;
+    py_[i] = desc.position.y;
+    pz_[i] = desc.position.z;
+    vx_[i] = desc.velocity.x;
+    vy_[i] = desc.velocity.y;
+    vz_[i] = desc.velocity.z;
+    life_[i] = desc.life;
+    scale_[i] = desc.scale;
+    count_++;
+    alive_ += desc.life >= 0;
+    return true;
+  }
+
+  void ParticleSystem::Clear()
+  {
+    head_ = 0;
+    count_ = 0;
+    alive_ = 0;
+    budget_ = emitBudgetPerTick_;
+    std::fill(life_.begin(), life_.end(), -1.0f);
+    std::fill(blockTick_.begin(), blockTick_.end(), tick_);
+  }
+
+  void ParticleSystem::Update(float dt, const ParticleView& view, ThreadPool& workers)
+  {
+    tick_++;
+
+    // with drag d per tick, n ticks at once scale the velocity by d^n and add a * dt * (1 + d + ... + d^(n-1)),
+    // while the position moves by the sum of the velocities at the end of each of those ticks
+    float velocityScale = 1, dvScale = 0, positionScale = 0, dpScale = 0;
+    for (uint32_t n = 1; n < steps_.size(); n++)
+    {
+      velocityScale *= drag;
+      dvScale = dvScale * drag + 1;
+      positionScale += velocityScale;
+      dpScale += dvScale;
+      steps_[n] =
+      {
+        .velocityScale = velocityScale,
+        .dv = acceleration * dt * dvScale,
+        .positionScale = positionScale * dt,
+        .dp = acceleration * dt * dt * dpScale,
+        .life = dt * n,
+      };
+    }
+
+    // blocks are staggered by their index, so blocks with the same stride are spread evenly over the ticks
+    std::atomic<size_t> died{ 0 };
+    workers.ParallelFor(LiveBlockCount(), BLOCKS_PER_JOB, [this, &view, &died](size_t v)
+    {
+      const size_t block = LiveBlock(v);
+      const uint32_t stride = BlockStride(block, view);
+      if (stride == 0)
+      {
+        // nothing alive in the block, there's nothing to catch up on
+        blockTick_[block] = tick_;
+        return;
+      }
+
+      const uint32_t behind = tick_ - blockTick_[block];
+      if (behind >= stride && (tick_ + block) % stride == 0)
+      {
+        died.fetch_add(UpdateBlock(block, behind), std::memory_order_relaxed);
+      }
+    });
+    alive_ -= died.load(std::memory_order_relaxed);
+
+    // drop dead particles at both ends of the live range
+    while (count_ > 0 && life_[head_] < 0)
+    {
+      head_ = Next(head_);
+      count_--;
+    }
+    while (count_ > 0 && life_[(head_ + count_ - 1) % capacity_] < 0)
+    {
+      count_--;
+    }
+
+    // compacting moves particles between blocks, so every block has to be caught up first.
+    // That's as expensive as a full update, so it's only done once the live range is mostly holes
+    if (alive_ * 2 < count_)
+    {
+      ForEachLiveBlock([this](size_t block) { SyncBlock(block); });
+      Compact();
+    }
+
+    budget_ = emitBudgetPerTick_;
+  }
+
+  uint32_t ParticleSystem::BlockStride(size_t block, const ParticleView& view) const
+  {
+    // the first live particle stands in for the whole block, since particles in a block were mostly emitted together
+    const size_t first = block * BLOCK_SIZE;
+    size_t i = first;
+    while (i < first + BLOCK_SIZE && life_[i] < 0)
+    {
+      i++;
+    }
+    if (i == first + BLOCK_SIZE)
+    {
+      return 0;
+    }
+
+    const glm::vec3 position(px_[i], py_[i], pz_[i]);
+    const float distance = glm::distance(position, view.eye);
+    if (distance < lodNearDistance)
+    {
+      return 1;
+    }
+
+    // conservative frustum test with some slack for the rest of the block
+    const glm::vec4 clip = view.viewProj * glm::vec4(position, 1.0f);
+    const float slack = 0.2f * clip.w + 2.0f;
+    if (clip.w < -slack || glm::abs(clip.x) > clip.w + slack || glm::abs(clip.y) > clip.w + slack)
+    {
+      return MAX_STRIDE;
+    }
+
+    return distance < lodFarDistance ? 2 : 4;
+  }
+
+  void ParticleSystem::SyncBlock(size_t block)
+  {
+    if (const uint32_t behind = tick_ - blockTick_[block]; behind > 0)
+    {
+      alive_ -= UpdateBlock(block, behind);
+    }
+  }
+
+  size_t ParticleSystem::UpdateBlock(size_t block, uint32_t ticks)
+  {
+    // only blocks outside of the live range can fall further behind than the longest step, and those are all dead
+    const Step& step = steps_[std::min<size_t>(ticks, steps_.size() - 1)];
+    const Kernel kernel
+    {
+      .px = px_.data(), .py = py_.data(), .pz = pz_.data(),
+      .vx = vx_.data(), .vy = vy_.data(), .vz = vz_.data(),
+      .life = life_.data(),
+      .velocityScale = step.velocityScale,
+      .dv = step.dv,
+      .positionScale = step.positionScale,
+      .dp = step.dp,
+      .lifeStep = step.life,
+    };
+
+    const size_t first = block * BLOCK_SIZE;
+    const size_t died = Integrate(kernel, first, first + BLOCK_SIZE);
+    if (grid_.width > 0)
+    {
+      Collide(step, first, first + BLOCK_SIZE);
+    }
+    blockTick_[block] = tick_;
+    return died;
+  }
+
+  void ParticleSystem::SetColliders(std::span<const Aabb> boxes)
+  {
+    grid_.width = 0;
+    grid_.depth = 0;
+    grid_.cellStart.clear();
+    for (auto* array : { &grid_.minX, &grid_.minY, &grid_.minZ, &grid_.maxX, &grid_.maxY, &grid_.maxZ })
+    {
+      array->clear();
+    }
+
+    if (boxes.empty())
+    {
+      return;
+    }
+
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    for (const auto& box : boxes)
+    {
+      lo = glm::min(lo, glm::vec2(box.min.x, box.min.z) - COLLIDER_MARGIN);
+      hi = glm::max(hi, glm::vec2(box.max.x, box.max.z) + COLLIDER_MARGIN);
+    }
+
+    // big levels get bigger cells instead of an unbounded number of them
+    const glm::vec2 extent = hi - lo;
+    grid_.origin = lo;
+    grid_.cellSize = std::max(COLLIDER_CELL_SIZE, std::max(extent.x, extent.y) / COLLIDER_MAX_CELLS_PER_AXIS);
+    grid_.width = std::max(1u, static_cast<uint32_t>(std::ceil(extent.x / grid_.cellSize)));
+    grid_.depth = std::max(1u, static_cast<uint32_t>(std::ceil(extent.y / grid_.cellSize)));
+
+    auto forEachCell = [this](const Aabb& box, auto&& fn)
+    {
+      const glm::vec2 boxLo = (glm::vec2(box.min.x, box.min.z) - COLLIDER_MARGIN - grid_.origin) / grid_.cellSize;
+      const glm::vec2 boxHi = (glm::vec2(box.max.x, box.max.z) + COLLIDER_MARGIN - grid_.origin) / grid_.cellSize;
+      const uint32_t x0 = static_cast<uint32_t>(std::max(boxLo.x, 0.0f));
+      const uint32_t z0 = static_cast<uint32_t>(std::max(boxLo.y, 0.0f));
+      const uint32_t x1 = std::min(static_cast<uint32_t>(boxHi.x), grid_.width - 1);
+      const uint32_t z1 = std::min(static_cast<uint32_t>(boxHi.y), grid_.depth - 1);
+      for (uint32_t z = z0; z <= z1; z++)
+      {
+        for (uint32_t x = x0; x <= x1; x++)
+        {
+          fn(z * grid_.width + x);
+        }
+      }
+    };
+
+    // count boxes per cell, round each cell up to a multiple of 4, then fill
+    std::vector<uint32_t> counts(size_t(grid_.width) * grid_.depth);
+    for (const auto& box : boxes)
+    {
+      forEachCell(box, [&counts](uint32_t cell) { counts[cell]++; });
+    }
+
+    grid_.cellStart.resize(counts.size() + 1);
+    grid_.cellStart[0] = 0;
+    for (size_t c = 0; c < counts.size(); c++)
+    {
+      grid_.cellStart[c + 1] = grid_.cellStart[c] + ((counts[c] + 3) & ~3u);
+    }
+
+    // padding boxes are a single point far outside of the level, which no segment can reach
+    const size_t total = grid_.cellStart.back();
+    for (auto* array : { &grid_.minX, &grid_.minY, &grid_.minZ, &grid_.maxX, &grid_.maxY, &grid_.maxZ })
+    {
+      array->assign(total, 1e30f);
+    }
+
+    std::fill(counts.begin(), counts.end(), 0);
+    for (const auto& box : boxes)
+    {
+      forEachCell(box, [&](uint32_t cell)
+        {
+          const size_t b = grid_.cellStart[cell] + counts[cell]++;
+          grid_.minX[b] = box.min.x; grid_.minY[b] = box.min.y; grid_.minZ[b] = box.min.z;
+          grid_.maxX[b] = box.max.x; grid_.maxY[b] = box.max.y; grid_.maxZ[b] = box.max.z;
+        });
+    }
+  }
+
+  void ParticleSystem::Collide(const Step& step, size_t first, size_t last)
+  {
+    const BoxArrays boxes
+    {
+      grid_.minX.data(), grid_.minY.data(), grid_.minZ.data(),
+      grid_.maxX.data(), grid_.maxY.data(), grid_.maxZ.data(),
+    };
+
+    // the cost per particle is one cell lookup plus the boxes in that cell, so the cost of a tick is bounded by
+    // the capacity times the most crowded cell
+    for (size_t i = first; i < last; i++)
+    {
+      if (life_[i] < 0)
+      {
+        continue;
+      }
+
+      const glm::vec3 p1(px_[i], py_[i], pz_[i]);
+      const glm::vec2 cellPos = (glm::vec2(p1.x, p1.z) - grid_.origin) / grid_.cellSize;
+      if (cellPos.x < 0 || cellPos.y < 0 || cellPos.x >= grid_.width || cellPos.y >= grid_.depth)
+      {
+        continue;
+      }
+
+      const size_t cell = static_cast<size_t>(cellPos.y) * grid_.width + static_cast<size_t>(cellPos.x);
+      const size_t begin = grid_.cellStart[cell];
+      const size_t end = grid_.cellStart[cell + 1];
+      if (begin == end)
+      {
+        continue;
+      }
+
+      // reconstruct where the particle was before the step. Steps covering several ticks move along a parabola,
+      // which is treated as a straight segment
+      glm::vec3 v(vx_[i], vy_[i], vz_[i]);
+      const glm::vec3 d = (v - step.dv) / step.velocityScale * step.positionScale + step.dp;
+      const glm::vec3 p0 = p1 - d;
+      const glm::vec3 invD = 1.0f / glm::vec3(
+        d.x != 0 ? d.x : 1e-20f,
+        d.y != 0 ? d.y : 1e-20f,
+        d.z != 0 ? d.z : 1e-20f);
+      const float radius = scale_[i];
+
+      const Hit hit = FindHit(boxes, begin, end, p0, invD, radius);
+      if (hit.box == end)
+      {
+        continue;
+      }
+
+      // the contact normal is the axis whose slab was entered last
+      const size_t b = hit.box;
+      const glm::vec3 tEnter = glm::min(
+        (glm::vec3(grid_.minX[b], grid_.minY[b], grid_.minZ[b]) - radius - p0) * invD,
+        (glm::vec3(grid_.maxX[b], grid_.maxY[b], grid_.maxZ[b]) + radius - p0) * invD);
+      const int axis = tEnter.x >= tEnter.y && tEnter.x >= tEnter.z ? 0 : (tEnter.y >= tEnter.z ? 1 : 2);
+
+      // stop at the surface, reflect the normal velocity and slow down the tangential velocity
+      glm::vec3 p = p0 + d * hit.t;
+      p[axis] -= std::copysign(1e-4f, d[axis]);
+      const float normalVelocity = v[axis];
+      v *= 1.0f - friction;
+      v[axis] = -normalVelocity * restitution;
+
+      px_[i] = p.x; py_[i] = p.y; pz_[i] = p.z;
+      vx_[i] = v.x; vy_[i] = v.y; vz_[i] = v.z;
+    }
+  }
+
+  void ParticleSystem::Compact()
+  {
+    // one stable pass over the live range, so particles stay ordered from oldest to newest
+    size_t alive = 0;
+    size_t write = head_;
+    for (size_t n = 0, read = head_; n < count_; n++, read = Next(read))
+    {
+      if (life_[read] < 0)
+      {
+        continue;
+      }
+
+      px_[write] = px_[read]; py_[write] = py_[read]; pz_[write] = pz_[read];
+      vx_[write] = vx_[read]; vy_[write] = vy_[read]; vz_[write] = vz_[read];
+      life_[write] = life_[read];
+      scale_[write] = scale_[read];
+      write = Next(write);
+      alive++;
+    }
+
+    // keep every slot outside of the live range dead
+    for (size_t n = alive; n < count_; n++, write = Next(write))
+    {
+      life_[write] = -1.0f;
+    }
+
+    assert(alive == alive_);
+    count_ = alive;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "macros.h"
+
+class ThreadPool;
+
+namespace Game
+{
+  struct ParticleDesc
+  {
+    glm::vec3 position{};
+    glm::vec3 velocity{};
+    float scale{ 1 };
+    float life{};
+  };
+
+  struct Aabb
+  {
+    glm::vec3 min{};
+    glm::vec3 max{};
+  };
+
+  // where the particles are seen from, used to pick how often each part of the system is simulated
+  struct ParticleView
+  {
+    glm::vec3 eye{};
+    glm::mat4 viewProj{ 1 };
+  };
+
+  // explosion debris, kept out of the entity manager as plain structure-of-arrays so the whole set can be
+  // integrated with SIMD. Particles die when their life drops below zero and are compacted away in bulk.
+  // Storage is a ring allocated once up front: when it's full, emitting overwrites the oldest particle, and
+  // only a limited number of particles can be emitted per tick, so the cost of a tick is bounded.
+  // Particles are simulated in blocks, and blocks that are far away or off-screen are only updated every few ticks.
+  // Skipped ticks are caught up exactly when a block is updated, since the motion is purely ballistic
+  class ParticleSystem
+  {
+  public:
+    ParticleSystem(size_t capacity, size_t emitBudgetPerTick);
+
+    NOCOPY_NOMOVE(ParticleSystem)
+
+    // returns false if this tick's emission budget is used up
+    bool Emit(const ParticleDesc& desc);
+    void Clear();
+
+    // static boxes that particles bounce off of. They're put in a uniform grid over the XZ plane, so each particle
+    // is only tested against the few boxes around it. Meant to be called once per level load
+    void SetColliders(std::span<const Aabb> boxes);
+
+    // advances the simulation by one tick of length dt: applies drag, acceleration and velocity, decrements life,
+    // removes dead particles, then refills the emission budget. Blocks whose stride skips this tick aren't touched.
+    // Blocks are independent, so they're spread over the workers
+    void Update(float dt, const ParticleView& view, ThreadPool& workers);
+
+    size_t Size() const { return alive_; }
+    size_t Capacity() const { return capacity_; }
+    size_t EmitBudget() const { return budget_; }
+
+    // calls fn(glm::vec3 position, float scale) for every live particle, from oldest to newest.
+    // Particles in blocks that skipped recent ticks are reported where they were last simulated
+    template<typename Fn>
+    void ForEach(Fn&& fn) const
+    {
+      for (size_t n = 0, i = head_; n < count_; n++, i = Next(i))
+      {
+        if (life_[i] >= 0)
+        {
+          fn(glm::vec3(px_[i], py_[i], pz_[i]), scale_[i]);
+        }
+      }
+    }
+
+    glm::vec3 acceleration{ 0, -8, 0 };
+    float drag = 0.98f; // velocity is multiplied by this once per update
+    float restitution = 0.4f; // fraction of the velocity along the contact normal kept after a bounce
+    float friction = 0.3f; // fraction of the tangential velocity lost in a bounce
+
+    // blocks closer than lodNearDistance are updated every tick, then every 2 ticks up to lodFarDistance and every
+    // 4 ticks beyond that. Off-screen blocks that aren't near are updated every MAX_STRIDE ticks
+    float lodNearDistance = 20.0f;
+    float lodFarDistance = 50.0f;
+
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr uint32_t MAX_STRIDE = 8;
+
+  private:
+    // coefficients that advance a particle by some number of ticks at once
+    struct Step
+    {
+      float velocityScale{}; // v' = v * velocityScale + dv
+      glm::vec3 dv{};
+      float positionScale{}; // p' = p + v * positionScale + dp, with v from before the step
+      glm::vec3 dp{};
+      float life{};
+    };
+
+    size_t Next(size_t i) const { return i + 1 == capacity_ ? 0 : i + 1; }
+    // blocks that overlap the live range. LiveBlock(v) is the v-th of them, counting from the one holding head_
+    size_t LiveBlockCount() const
+    {
+      return std::min(blockTick_.size(), (head_ % BLOCK_SIZE + count_ + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    }
+    size_t LiveBlock(size_t v) const { return (head_ / BLOCK_SIZE + v) % blockTick_.size(); }
+
+    // calls fn(size_t block) once for every block that overlaps the live range
+    template<typename Fn>
+    void ForEachLiveBlock(Fn&& fn)
+    {
+      for (size_t v = 0, visit = LiveBlockCount(); v < visit; v++)
+      {
+        fn(LiveBlock(v));
+      }
+    }
+
+    static constexpr size_t BLOCKS_PER_JOB = 16; // enough particles per job to be worth handing to a worker
+
+    uint32_t BlockStride(size_t block, const ParticleView& view) const;
+    void SyncBlock(size_t block);
+    // returns how many particles died, which the caller takes off alive_ so blocks can be updated concurrently
+    size_t UpdateBlock(size_t block, uint32_t ticks);
+    void Compact();
+    void Collide(const Step& step, size_t first, size_t last);
+
+    // boxes are stored per cell, so a cell's boxes are contiguous and can be loaded straight into SIMD registers.
+    // Each cell is padded to a multiple of 4 with boxes that can't be hit
+    struct ColliderGrid
+    {
+      glm::vec2 origin{}; // XZ corner of the grid
+      float cellSize{ 1 };
+      uint32_t width{};
+      uint32_t depth{};
+      std::vector<uint32_t> cellStart; // width * depth + 1 offsets into the box arrays
+      std::vector<float> minX, minY, minZ;
+      std::vector<float> maxX, maxY, maxZ;
+    } grid_;
+
+    const size_t capacity_;
+    const size_t emitBudgetPerTick_;
+    size_t budget_;
+    size_t head_ = 0;  // start of the live range, which may contain dead particles that haven't been compacted yet
+    size_t count_ = 0; // length of the live range
+    size_t alive_ = 0;
+
+    // every slot outside of the live range has a negative life, so whole blocks can be integrated blindly
+    uint32_t tick_ = 0;
+    std::vector<uint32_t> blockTick_; // tick each block was last simulated up to
+    std::array<Step, 2 * MAX_STRIDE> steps_{}; // steps_[n] advances by n ticks
+
+    std::vector<float> px_, py_, pz_;
+    std::vector<float> vx_, vy_, vz_;
+    std::vector<float> life_;
+    std::vector<float> scale_;
+  };
+}
\ No newline at end of file
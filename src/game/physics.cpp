@@ -4,13 +4,19 @@
 #include "gfx/mesh.h"
 #include "gfx/camera.h"
 #include "world.h"
+#include "utility/mpsc_queue.h"
+#include "utility/thread_pool.h"
 
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
-#include <bit>
+#include <queue>
+#include <tuple>
+#include <span>
 #include <execution>
+#include <atomic>
+#include <chrono>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -32,6 +38,8 @@
 #include <PhysX/physx/include/PxScene.h>
 #include <PhysX/physx/include/PxSimulationEventCallback.h>
 
+#include "physics_allocator.h"
+
 #define PX_RELEASE(x)	if(x)	{ x->release(); x = NULL;	}
 #define GET_OBJ(ent) world->entityManager.GetObject(ent)
 
@@ -41,31 +49,24 @@ struct PhysicsImpl;
 
 namespace
 {
-  static thread_local uint64_t x = 123456789, y = 362436069, z = 521288629;
-
-  uint64_t xorshf96()
+  // adds the velocity change an explosion at center gives to each of the objects at (x, y, z) to (fx, fy, fz).
+  // Branchless over plain arrays so the compiler can vectorise it; objects beyond maxDist get no push
+  void ExplosionFalloff(glm::vec3 center, float maxDist, float maxForce,
+    std::span<const float> x, std::span<const float> y, std::span<const float> z,
+    std::span<float> fx, std::span<float> fy, std::span<float> fz)
   {
-    x ^= x << 16;
-    x ^= x >> 5;
-    x ^= x << 1;
-
-    uint64_t t = x;
-    x = y;
-    y = z;
-    z = t ^ x ^ y;
-
-    return z;
-  }
-
-  double rng()
-  {
-    uint64_t bits = 1023ull << 52ull | xorshf96() & 0xfffffffffffffull;
-    return std::bit_cast<double>(bits) - 1.0;
-  }
-
-  double rng(double low, double high)
-  {
-    return (rng() * (high - low)) + low;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+      const float dx = x[i] - center.x;
+      const float dy = y[i] - center.y;
+      const float dz = z[i] - center.z;
+      const float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+      const float invDist = 1.0f / std::max(dist, 1e-4f);
+      const float strength = dist < maxDist ? std::min(maxForce * invDist, maxForce) : 0.0f;
+      fx[i] += dx * invDist * strength;
+      fy[i] += dy * invDist * strength;
+      fz[i] += dz * invDist * strength;
+    }
   }
 
   PxVec3 toPxVec3(const glm::vec3& v)
@@ -110,23 +111,49 @@ namespace
     };
   }
   
+  // what a shape belongs to, stored in word0 of its simulation filter data
+  enum FilterCategory : PxU32
+  {
+    FILTER_LAVA      = 1 << 0,
+    FILTER_TERRAIN   = 1 << 1,
+    FILTER_EXPLOSIVE = 1 << 2,
+    FILTER_PROP      = 1 << 3,
+  };
+
   PxFilterFlags contactReportFilterShader(
     [[maybe_unused]] PxFilterObjectAttributes attributes0, [[maybe_unused]] PxFilterData filterData0,
     [[maybe_unused]] PxFilterObjectAttributes attributes1, [[maybe_unused]] PxFilterData filterData1,
     PxPairFlags& pairFlags, [[maybe_unused]] const void* constantBlock, [[maybe_unused]] PxU32 constantBlockSize)
   {
-    // all initial and persisting reports for everything, with per-point data
     pairFlags = PxPairFlag::eSOLVE_CONTACT
       | PxPairFlag::eDETECT_DISCRETE_CONTACT
-      | PxPairFlag::eNOTIFY_TOUCH_FOUND
-      //| PxPairFlag::eNOTIFY_TOUCH_PERSISTS
-      | PxPairFlag::eNOTIFY_CONTACT_POINTS
       | PxPairFlag::eDETECT_CCD_CONTACT
-      | PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND
       ;
+
+    // the only reports gameplay uses are the ones that set off explosives: being hit hard enough, or touching lava.
+    // Every other pair (resting props, bombs sitting on platforms) is simulated without generating any
+    const PxU32 categories = filterData0.word0 | filterData1.word0;
+    if (categories & FILTER_EXPLOSIVE)
+    {
+      pairFlags |= PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND;
+      if (categories & FILTER_LAVA)
+      {
+        pairFlags |= PxPairFlag::eNOTIFY_TOUCH_FOUND;
+      }
+    }
     return PxFilterFlag::eDEFAULT;
   }
 
+  void SetFilterCategory(PxRigidActor* actor, PxU32 category)
+  {
+    std::array<PxShape*, 4> shapes;
+    const PxU32 count = actor->getShapes(shapes.data(), PxU32(shapes.size()));
+    for (PxU32 i = 0; i < count; i++)
+    {
+      shapes[i]->setSimulationFilterData(PxFilterData(category, 0, 0, 0));
+    }
+  }
+
   class ErrorCallback : public PxDefaultErrorCallback
   {
   public:
@@ -156,6 +183,44 @@ private:
   void onContact(const PxContactPairHeader& pairHeader, const PxContactPair* pairs, PxU32 nbPairs);
 };
 
+// continuation of a simulation step, run by a PhysX worker once the step is done. The main thread waits on the flag
+// only when it actually needs the results, instead of polling fetchResults every frame
+class StepCompletionTask : public PxLightCpuTask
+{
+public:
+  std::atomic<bool> done{ false };
+
+  void run() override
+  {
+    done.store(true);
+    done.notify_all();
+  }
+
+  const char* getName() const override { return "StepCompletionTask"; }
+};
+
+// hands PhysX tasks to the engine's worker pool, so physics shares its threads with everything else instead of
+// spinning up its own. With no workers, tasks run inline on the thread that submits them
+class PoolCpuDispatcher : public PxCpuDispatcher
+{
+public:
+  explicit PoolCpuDispatcher(ThreadPool& pool) : pool_(pool) {}
+
+  void submitTask(PxBaseTask& task) override
+  {
+    pool_.Submit([&task]
+    {
+      task.run();
+      task.release();
+    });
+  }
+
+  PxU32 getWorkerCount() const override { return static_cast<PxU32>(pool_.ThreadCount()); }
+
+private:
+  ThreadPool& pool_;
+};
+
 class UserControllerHitReport : public PxUserControllerHitReport
 {
 public:
@@ -175,6 +240,7 @@ struct PhysicsImpl
   // objects
   ////////////////////////////////////////////////////////
   Game::entity_t placementIndicator{};
+  Game::entity_t highlighted{}; // explosive currently glowing because the player is looking at it
   Game::Physics* physics{};
 
   const float gravity = -15;
@@ -187,19 +253,40 @@ struct PhysicsImpl
   const float maxXZSpeed = moveSpeed;
 
   const double tick = 1.0 / 100.0;
-  bool resultsReady = true;
   double accumulator = 0;
 
+  // a step is started at the end of a frame and simulates on the PhysX workers while the frame renders from the
+  // entity transforms, which only change when the step is finished. Finishing waits for it, then applies its results
+  enum class StepState
+  {
+    IDLE,     // no step in progress
+    RUNNING,  // simulating, the scene can't be modified
+    FINISHED, // results applied, but the step hasn't been accounted for by the accumulator yet
+  } stepState = StepState::IDLE;
+  StepCompletionTask stepCompletion;
+  static constexpr int MAX_STEPS_PER_FRAME = 5; // time beyond this is dropped, so slow frames can't snowball
+  // never reset, so the PreviousPose of an entity from an earlier level can't match it. Starts at 1 so a freshly
+  // spawned entity, whose PreviousPose is still at step 0, isn't blended from the origin
+  uint32_t stepCount = 1;
+  Game::Physics::EventStats eventStats; // only touched on the main thread, which is where PhysX calls back from
+
   World* world = nullptr;
   PxController* controller = nullptr;
   UserControllerHitReport* controllerHitCallback{};
   glm::vec3 pVel{};
   bool pExploded = false; // true when exploded until touching the ground again
   PxControllerCollisionFlags cFlags{};
-  float pAccum = 0;
-  const double pTick = 1.0 / 200.0;
-
-  physx::PxDefaultAllocator gAllocator;
+  static constexpr int playerSubsteps = 2; // the controller moves twice per step
+  glm::vec3 eyePosition{}; // where the player's eyes were after the last finished step. The camera is blended towards it
+  glm::vec3 previousEyePosition{};
+
+  PhysicsAllocator gAllocator;
+  PhysicsAllocator::Stats memoryStats; // last snapshot shown by DrawMemoryStats
+  std::vector<uint64_t> sampledAllocations; // allocation totals per type when the rates were last taken
+  std::vector<float> allocationRates;
+  uint64_t sampledHeapAllocations = 0;
+  float heapAllocationRate = 0;
+  double rateSampleTime = 0;
   ErrorCallback gErrorCallback;
   
   physx::PxFoundation* gFoundation = nullptr;
@@ -207,26 +294,90 @@ struct PhysicsImpl
 
   ContactReportCallback* gContactReportCallback{};
 
-  physx::PxDefaultCpuDispatcher* gDispatcher = nullptr;
+  ThreadPool& workers;
+  PoolCpuDispatcher gDispatcher{ workers };
   physx::PxScene* gScene = nullptr;
   physx::PxPvd* gPvd = nullptr;
   physx::PxCooking* gCooking = nullptr;
   physx::PxControllerManager* gCManager = nullptr;
   std::array<physx::PxMaterial*, 3> gMaterials;
 
-  std::unordered_map<physx::PxRigidActor*, Game::entity_t> gActorToEntity;
-  std::unordered_map<Game::entity_t, physx::PxRigidActor*> gEntityToActor;
+  // the actor of an object carries its entity in userData, and entityActors is indexed by entity index, so mapping
+  // either way is a load instead of a hash lookup. Actors that aren't objects (the player's capsule, the lava plane)
+  // have null userData
+  std::vector<physx::PxRigidActor*> entityActors;
+
+  // what the physics callbacks saw. Callbacks only record these, and ProcessEvents acts on them once a step's results
+  // have been fetched, so callbacks never touch game state and are safe to run on any thread
+  struct PhysicsEvent
+  {
+    enum class Type : uint8_t
+    {
+      EXPLOSIVE_HIT,     // an explosive was hit hard enough or touched lava
+      PLAYER_HIT_OBJECT, // the player's controller ran into an object
+      PLAYER_HIT_LAVA,
+    } type{};
+    Game::entity_t entity{};
+    float playerSpeed{}; // speed of the player when the controller hit something
+  };
+  MpscQueue<PhysicsEvent, 4096> events; // events that don't fit are dropped
+
+  // explosions waiting to go off, ordered by the physics tick they're due and then by entity so the order doesn't
+  // depend on pointer values. An entity is only in explosionTimes while it has a live entry in the queue
+  struct ScheduledExplosion
+  {
+    uint32_t tick{};
+    Game::entity_t entity{};
+
+    bool operator>(const ScheduledExplosion& other) const
+    {
+      return std::tie(tick, entity.index, entity.version) > std::tie(other.tick, other.entity.index, other.entity.version);
+    }
+  };
+  std::priority_queue<ScheduledExplosion, std::vector<ScheduledExplosion>, std::greater<>> explosionQueue;
+  std::unordered_map<Game::entity_t, uint32_t> explosionTimes;
 
-  std::unordered_set<PxRigidActor*> explodeList;
+  struct DueExplosion
+  {
+    Game::entity_t entity{};
+    PxRigidActor* actor{};
+    glm::vec3 position{};
+  };
+  std::array<std::vector<DueExplosion>, MAX_EXPLOSIONS_PER_TICK> explosionClusters;
+  uint32_t physicsTick = 0; // number of physics steps taken since the level was loaded
+  const uint32_t chainDelayTicks = static_cast<uint32_t>(EXPLOSION_CHAIN_DELAY / tick + 0.5);
+  std::vector<float> explosionRandoms; // scratch space for the random values of one explosion's particles
+
+  // scratch space for finding and pushing the neighbors of an explosion
+  static constexpr PxU32 MAX_EXPLOSION_NEIGHBORS = 1024;
+  std::vector<PxOverlapHit> explosionHits = std::vector<PxOverlapHit>(MAX_EXPLOSION_NEIGHBORS);
+  std::vector<PxRigidDynamic*> pushedActors;
+  std::vector<float> pushX, pushY, pushZ;
+  std::vector<float> forceX, forceY, forceZ;
+
+  // actor state saved right after a level is loaded. Actors in it are only removed from the scene when their entity
+  // goes away, so restarting can add them back instead of recreating them
+  struct ActorState
+  {
+    PxRigidActor* actor{};
+    Game::entity_t entity{};
+    PxTransform pose{ PxIdentity };
+    PxVec3 linearVelocity{ 0 };
+    PxVec3 angularVelocity{ 0 };
+    bool sleeping{};
+  };
+  std::vector<ActorState> snapshot;
+  std::unordered_set<PxRigidActor*> snapshotActors;
 
 
   ////////////////////////////////////////////////////////
   // functions
   ////////////////////////////////////////////////////////
-  PhysicsImpl()
+  PhysicsImpl(ThreadPool& pool) : workers(pool)
   {
     gContactReportCallback = new ContactReportCallback(this);
     gFoundation = PxCreateFoundation(PX_PHYSICS_VERSION, gAllocator, gErrorCallback);
+    gFoundation->setReportAllocationNames(true); // release builds of PhysX don't pass type names otherwise
 
 #if !NDEBUG
     gPvd = PxCreatePvd(*gFoundation);
@@ -240,14 +391,14 @@ struct PhysicsImpl
     gPhysics = PxCreatePhysics(PX_PHYSICS_VERSION, *gFoundation, tolerances, true, gPvd);
     gCooking = PxCreateCooking(PX_PHYSICS_VERSION, *gFoundation, PxCookingParams(tolerances));
     PxInitExtensions(*gPhysics, gPvd);
-    gDispatcher = PxDefaultCpuDispatcherCreate(0);
 
     PxSceneDesc sceneDesc(gPhysics->getTolerancesScale());
-    sceneDesc.cpuDispatcher = gDispatcher;
+    sceneDesc.cpuDispatcher = &gDispatcher;
     sceneDesc.gravity = PxVec3(0, -25.0f, 0);
     sceneDesc.filterShader = contactReportFilterShader;
     sceneDesc.simulationEventCallback = gContactReportCallback;
     sceneDesc.solverType = PxSolverType::ePGS; // faster than eTGS
+    sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS; // lets transform syncing visit only the actors that moved
     //sceneDesc.flags |= PxSceneFlag::
     //sceneDesc.flags |= PxSceneFlag::eREQUIRE_RW_LOCK;
 
@@ -264,16 +415,17 @@ struct PhysicsImpl
     gMaterials[(int)Game::MaterialType::OBJECT] = gPhysics->createMaterial(0.2f, 0.4f, 0.7f);
 
     PxRigidStatic* groundPlane = PxCreatePlane(*gPhysics, PxPlane(0, 1, 0, 0), *gMaterials[(int)Game::MaterialType::TERRAIN]);
+    SetFilterCategory(groundPlane, FILTER_LAVA);
     gScene->addActor(*groundPlane);
   }
 
   ~PhysicsImpl()
   {
+    WaitForResults();
     gScene->lockWrite();
     PX_RELEASE(gCManager);
     gScene->unlockWrite();
     PX_RELEASE(gScene);
-    PX_RELEASE(gDispatcher);
     PxCloseExtensions();
     PX_RELEASE(gCooking);
     PX_RELEASE(gPhysics);
@@ -288,108 +440,508 @@ struct PhysicsImpl
     delete gContactReportCallback;
   }
 
+  // the scene can't be modified while it's simulating. This throws the results of a running step away, which is only
+  // meant for when everything is about to be reset anyway
+  void WaitForResults()
+  {
+    if (stepState == StepState::RUNNING)
+    {
+      stepCompletion.done.wait(false);
+      gScene->fetchResults(true);
+    }
+    stepState = StepState::IDLE;
+  }
+
+  // removes an actor whose entity is gone, keeping it alive if a snapshot still refers to it
+  void DetachActor(PxRigidActor* actor)
+  {
+    if (snapshotActors.contains(actor))
+    {
+      gScene->removeActor(*actor);
+    }
+    else
+    {
+      actor->release();
+    }
+  }
+
   void Reset()
   {
-    for (auto& [actor, object] : gActorToEntity)
+    WaitForResults();
+
+    for (auto* actor : entityActors)
+    {
+      if (actor && !snapshotActors.contains(actor))
+      {
+        actor->release();
+      }
+    }
+    for (auto* actor : snapshotActors)
     {
       actor->release();
     }
 
-    gActorToEntity.clear();
-    gEntityToActor.clear();
+    entityActors.clear();
+    snapshot.clear();
+    snapshotActors.clear();
+    gAllocator.BeginLevel(); // ends when the loaded level is snapshotted
+    DiscardEvents();
+    ClearExplosions();
+    highlighted = {};
+    accumulator = 0;
 
     // make placement indicator
-    auto& newBox = world->MakeBox({ 0, 0, 0 }, glm::vec3(EXPLOSIVE_SIZE));
+    auto newBox = world->MakeBox({ 0, 0, 0 }, glm::vec3(EXPLOSIVE_SIZE));
     newBox.renderable.color = glm::vec4(0.5, 0.5, 0.5, 1.0);
     placementIndicator = newBox.entity;
-    assert(placementIndicator > 0);
+    assert(placementIndicator);
+  }
+
+  void DrawMemoryStats()
+  {
+    gAllocator.GetStats(memoryStats);
+
+    // rates are taken over about a second, so they're readable
+    const double now = glfwGetTime();
+    if (const double elapsed = now - rateSampleTime; elapsed >= 1.0)
+    {
+      sampledAllocations.resize(memoryStats.types.size());
+      allocationRates.resize(memoryStats.types.size());
+      for (size_t i = 0; i < memoryStats.types.size(); i++)
+      {
+        allocationRates[i] = static_cast<float>((memoryStats.types[i].allocations - sampledAllocations[i]) / elapsed);
+        sampledAllocations[i] = memoryStats.types[i].allocations;
+      }
+      heapAllocationRate = static_cast<float>((memoryStats.heapAllocations - sampledHeapAllocations) / elapsed);
+      sampledHeapAllocations = memoryStats.heapAllocations;
+      rateSampleTime = now;
+    }
+
+    ImGui::Begin("PhysX memory", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("Live: %.1f KiB (peak %.1f KiB)", memoryStats.liveBytes / 1024.0, memoryStats.peakBytes / 1024.0);
+    ImGui::Text("Held from heap: %.1f KiB (%zu level arena blocks)", memoryStats.reservedBytes / 1024.0, memoryStats.arenaBlocks);
+    ImGui::Text("Heap allocations: %llu (%.0f/s)", static_cast<unsigned long long>(memoryStats.heapAllocations), heapAllocationRate);
+
+    // biggest users first. Types that were only seen after the last rate sample have no rate yet
+    std::vector<size_t> order;
+    for (size_t i = 0; i < memoryStats.types.size(); i++)
+    {
+      if (memoryStats.types[i].allocations > 0)
+      {
+        order.push_back(i);
+      }
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+      {
+        return memoryStats.types[a].liveBytes > memoryStats.types[b].liveBytes;
+      });
+
+    if (ImGui::BeginTable("types", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+    {
+      ImGui::TableSetupColumn("Type");
+      ImGui::TableSetupColumn("Live KiB");
+      ImGui::TableSetupColumn("Peak KiB");
+      ImGui::TableSetupColumn("Count");
+      ImGui::TableSetupColumn("Allocs/s");
+      ImGui::TableHeadersRow();
+      for (size_t i : order)
+      {
+        const auto& type = memoryStats.types[i];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%.*s", static_cast<int>(type.name.size()), type.name.data());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", type.liveBytes / 1024.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", type.peakBytes / 1024.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%zu", type.liveCount);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.0f", i < allocationRates.size() ? allocationRates[i] : 0.0f);
+      }
+      ImGui::EndTable();
+    }
+    ImGui::End();
   }
 
   void SetPlayerPos(glm::vec3 pos)
   {
     controller->setPosition({ pos.x, pos.y, pos.z });
     pVel = glm::vec3(0);
+    eyePosition = previousEyePosition = pos + glm::vec3(0, .4, 0);
+  }
+
+  glm::vec3 PlayerEyePosition() const
+  {
+    const auto& p = controller->getPosition();
+    return { p.x, p.y + .4, p.z };
+  }
+
+  static Game::entity_t EntityOf(const PxActor* actor)
+  {
+    static_assert(sizeof(void*) >= sizeof(uint64_t), "entity handles are packed into a pointer");
+    const uint64_t bits = actor ? reinterpret_cast<uintptr_t>(actor->userData) : 0;
+    return { static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32) };
   }
 
+  // returns null if the entity has no actor
+  PxRigidActor* ActorOf(Game::entity_t entity) const
+  {
+    if (entity.index >= entityActors.size())
+    {
+      return nullptr;
+    }
+
+    // the slot may belong to a newer entity with the same index
+    auto* actor = entityActors[entity.index];
+    return actor && EntityOf(actor) == entity ? actor : nullptr;
+  }
+
+  void LinkActor(PxRigidActor* actor, Game::entity_t entity)
+  {
+    actor->userData = reinterpret_cast<void*>(static_cast<uintptr_t>(uint64_t(entity.version) << 32 | entity.index));
+    if (entity.index >= entityActors.size())
+    {
+      entityActors.resize(entity.index + 1);
+    }
+    entityActors[entity.index] = actor;
+  }
+
+  // detached actors keep their userData, snapshots put them back under the same entity anyway
   void FreeActor(PxRigidActor* actor)
   {
-    assert(gActorToEntity.contains(actor));
-    auto entity = gActorToEntity[actor];
-    assert(gEntityToActor.contains(entity));
-    gActorToEntity.erase(actor);
-    gEntityToActor.erase(entity);
-    actor->release();
+    const auto entity = EntityOf(actor);
+    assert(entity && ActorOf(entity) == actor);
+    entityActors[entity.index] = nullptr;
+    DetachActor(actor);
   }
 
-  void Explode(PxRigidActor* actor)
+  void SaveSnapshot()
+  {
+    gAllocator.EndLevel();
+    snapshot.clear();
+    snapshotActors.clear();
+    for (auto* actor : entityActors)
+    {
+      if (!actor)
+      {
+        continue;
+      }
+
+      ActorState state{ .actor = actor, .entity = EntityOf(actor), .pose = actor->getGlobalPose() };
+      if (auto* dynamic = actor->is<PxRigidDynamic>())
+      {
+        state.linearVelocity = dynamic->getLinearVelocity();
+        state.angularVelocity = dynamic->getAngularVelocity();
+        state.sleeping = dynamic->isSleeping();
+      }
+      snapshot.push_back(state);
+      snapshotActors.insert(actor);
+    }
+  }
+
+  // expects the entity manager to have been restored to the matching snapshot already
+  void RestoreSnapshot()
+  {
+    WaitForResults();
+
+    // actors created since the snapshot (e.g. placed bombs) don't come back
+    for (auto* actor : entityActors)
+    {
+      if (actor && !snapshotActors.contains(actor))
+      {
+        actor->release();
+      }
+    }
+    std::fill(entityActors.begin(), entityActors.end(), nullptr);
+
+    for (const auto& state : snapshot)
+    {
+      if (!state.actor->getScene())
+      {
+        gScene->addActor(*state.actor);
+      }
+
+      // static actors never move, so only dynamic ones need their state put back
+      if (auto* dynamic = state.actor->is<PxRigidDynamic>())
+      {
+        dynamic->setGlobalPose(state.pose);
+        dynamic->setLinearVelocity(state.linearVelocity);
+        dynamic->setAngularVelocity(state.angularVelocity);
+        dynamic->clearForce();
+        dynamic->clearTorque();
+        if (state.sleeping)
+        {
+          dynamic->putToSleep();
+        }
+        else
+        {
+          dynamic->wakeUp();
+        }
+      }
+
+      LinkActor(state.actor, world->entityManager.Restamp(state.entity));
+    }
+
+    // loading the entity snapshot gave every restored entity a new handle
+    placementIndicator = world->entityManager.Restamp(placementIndicator);
+    DiscardEvents();
+    ClearExplosions();
+    highlighted = {};
+    accumulator = 0;
+    pExploded = false;
+  }
+
+  void ClearExplosions()
+  {
+    explosionQueue = {};
+    explosionTimes.clear();
+    physicsTick = 0;
+  }
+
+  // events recorded before a restart refer to objects that don't exist anymore
+  void DiscardEvents()
+  {
+    PhysicsEvent event;
+    while (events.TryPop(event)) {}
+  }
+
+  void ProcessEvents()
+  {
+    PhysicsEvent event;
+    while (events.TryPop(event))
+    {
+      eventStats.events++;
+      switch (event.type)
+      {
+      case PhysicsEvent::Type::EXPLOSIVE_HIT:
+        ScheduleExplosion(event.entity, 0);
+        break;
+      case PhysicsEvent::Type::PLAYER_HIT_OBJECT:
+      {
+        // the object may have been picked up or blown up since it was hit
+        auto obj = world->entityManager.TryGetObject(event.entity);
+        if (!obj)
+        {
+          break;
+        }
+
+        if (obj->physics.isWinPlatform)
+        {
+          world->gameState = GameState::WIN_LEVEL;
+        }
+
+        if (obj->type == EntityType::EXPLOSIVE && event.playerSpeed > EXPLOSION_PLAYER_TRIGGER_FORCE)
+        {
+          ScheduleExplosion(event.entity, 0);
+        }
+        break;
+      }
+      case PhysicsEvent::Type::PLAYER_HIT_LAVA:
+        // cheaters are invincible
+        if (!world->cheats)
+        {
+          world->deathCounter++;
+          world->gameState = GameState::DEAD;
+        }
+        break;
+      }
+    }
+  }
+
+  // makes an explosive go off delayTicks physics ticks from now. Scheduling an explosive again only has an effect if
+  // it makes it go off sooner
+  void ScheduleExplosion(Game::entity_t entity, uint32_t delayTicks)
   {
-    assert(gActorToEntity.contains(actor));
-    auto entity = gActorToEntity[actor];
-    
     if (!entity)
     {
       return;
     }
 
-    glm::vec3 explosionCenter = world->entityManager.GetObject(entity).transform.position;
-
-    // make a bunch of tiny spheres go flying
-    for (int i = 0; i < 150; i++)
+    const uint32_t due = physicsTick + delayTicks;
+    auto [time, inserted] = explosionTimes.try_emplace(entity, due);
+    if (!inserted && time->second <= due)
     {
-      auto& newObj = world->MakeSphere(explosionCenter, rng(.2, .4));
-      newObj.type = EntityType::PARTICLE;
-      newObj.particle.life = rng(0, 2);
-      newObj.particle.velocity = glm::normalize(glm::vec3(rng(-8, 8), rng(-5, 15), rng(-8, 8))) * (float)rng(22, 32);
-      newObj.particle.acceleration = glm::vec3(0, -8, 0);
-      newObj.renderable.glow = { .4, .2, .1 };
+      return;
     }
 
-    for (auto& [otherActor, otherEntity] : gActorToEntity)
+    // an entry that gets superseded stays in the queue, and is skipped when popped because its time no longer matches
+    time->second = due;
+    explosionQueue.push({ due, entity });
+  }
+
+  // sets off the explosions that are due. Explosives that go off in the same tick close to each other are merged into
+  // one cluster, which costs about as much as a single explosion. At most MAX_EXPLOSIONS_PER_TICK clusters go off per
+  // tick, the rest stay in the queue for the next ticks, so a huge chain reaction is spread out over several frames
+  void ProcessExplosions()
+  {
+    size_t clusterCount = 0;
+    while (!explosionQueue.empty() && explosionQueue.top().tick <= physicsTick)
     {
-      if (otherActor == actor)
+      const auto entry = explosionQueue.top();
+      auto timeIt = explosionTimes.find(entry.entity);
+      auto* actor = ActorOf(entry.entity);
+
+      // drop superseded entries and explosives that were picked up or blown up since they were scheduled
+      if (timeIt == explosionTimes.end() || timeIt->second != entry.tick || !actor)
       {
+        explosionQueue.pop();
         continue;
       }
 
-      auto& otherObject = world->entityManager.GetObject(otherEntity);
+      const DueExplosion explosion{ entry.entity, actor, toGlmVec3(actor->getGlobalPose().p) };
+      auto cluster = std::find_if(explosionClusters.begin(), explosionClusters.begin() + clusterCount,
+        [&](const auto& members)
+        {
+          return glm::distance(members.front().position, explosion.position) < EXPLOSION_CLUSTER_RADIUS;
+        });
+      if (cluster == explosionClusters.begin() + clusterCount)
+      {
+        if (clusterCount == MAX_EXPLOSIONS_PER_TICK)
+        {
+          break;
+        }
+        explosionClusters[clusterCount++].clear();
+      }
+
+      cluster->push_back(explosion);
+      explosionTimes.erase(timeIt);
+      explosionQueue.pop();
+    }
+
+    // split the remaining particle budget between every cluster, so big chain reactions get fewer particles each
+    const size_t particleShare = clusterCount == 0 ? 0 : world->particles.EmitBudget() / clusterCount;
+    for (size_t i = 0; i < clusterCount; i++)
+    {
+      const auto& members = explosionClusters[i];
+      Explode(members, std::min(particleShare, std::min(EXPLOSION_PARTICLES * members.size(), EXPLOSION_CLUSTER_PARTICLES)));
+    }
+  }
+
+  // blows up a cluster of explosives at once. Other objects get the sum of every member's push, and the player is
+  // pushed by each member in turn just like separate explosions would, but particles are emitted and neighbors are
+  // gathered only once for the whole cluster
+  void Explode(std::span<const DueExplosion> members, size_t particleCount)
+  {
+    glm::vec3 explosionCenter{ 0 };
+    for (const auto& member : members)
+    {
+      explosionCenter += member.position / float(members.size());
+    }
+    float clusterExtent = 0;
+    for (const auto& member : members)
+    {
+      clusterExtent = glm::max(clusterExtent, glm::distance(member.position, explosionCenter));
+    }
+
+    // make a bunch of tiny spheres go flying, with every random value generated up front in a few batches
+    explosionRandoms.resize(particleCount * 6);
+    const std::span<float> dirX(explosionRandoms.data() + particleCount * 0, particleCount);
+    const std::span<float> dirY(explosionRandoms.data() + particleCount * 1, particleCount);
+    const std::span<float> dirZ(explosionRandoms.data() + particleCount * 2, particleCount);
+    const std::span<float> speed(explosionRandoms.data() + particleCount * 3, particleCount);
+    const std::span<float> scale(explosionRandoms.data() + particleCount * 4, particleCount);
+    const std::span<float> life(explosionRandoms.data() + particleCount * 5, particleCount);
+    world->rng.Fill(dirX, -8, 8);
+    world->rng.Fill(dirY, -5, 15);
+    world->rng.Fill(dirZ, -8, 8);
+    world->rng.Fill(speed, 22, 32);
+    world->rng.Fill(scale, .2f, .4f);
+    world->rng.Fill(life, 0, 2);
+    for (size_t i = 0; i < particleCount; i++)
+    {
+      world->particles.Emit(
+        {
+          .position = explosionCenter,
+          .velocity = glm::normalize(glm::vec3(dirX[i], dirY[i], dirZ[i])) * speed[i],
+          .scale = scale[i],
+          .life = life[i],
+        });
+    }
+
+    // only dynamic actors can be pushed or blown up, so the query can skip the (much bigger) static level geometry.
+    // eNO_BLOCK makes every hit a touch, otherwise the query would stop at the first one
+    PxOverlapBuffer overlap(explosionHits.data(), MAX_EXPLOSION_NEIGHBORS);
+    const PxSphereGeometry reach(glm::max(EXPLOSION_RECURSE_DIST, EXPLOSION_MAX_OBJECT_DIST) + clusterExtent);
+    gScene->overlap(reach, PxTransform(toPxVec3(explosionCenter)), overlap,
+      PxQueryFilterData(PxQueryFlag::eDYNAMIC | PxQueryFlag::eNO_BLOCK));
+
+    pushedActors.clear();
+    pushX.clear();
+    pushY.clear();
+    pushZ.clear();
+    for (PxU32 i = 0; i < overlap.getNbTouches(); i++)
+    {
+      // skip the cluster itself and actors that aren't objects (like the player's kinematic capsule)
+      auto* otherActor = overlap.getTouch(i).actor;
+      const auto otherEntity = EntityOf(otherActor);
+      if (!otherEntity ||
+        std::any_of(members.begin(), members.end(), [=](const auto& member) { return member.actor == otherActor; }))
+      {
+        continue;
+      }
 
       // explode other nearby explosives
-      float dist = glm::distance(otherObject.transform.position, explosionCenter);
-      if (otherObject.type == EntityType::EXPLOSIVE && dist < EXPLOSION_RECURSE_DIST)
+      const glm::vec3 otherPosition = toGlmVec3(otherActor->getGlobalPose().p);
+      const bool inRange = std::any_of(members.begin(), members.end(), [&](const auto& member)
+        {
+          return glm::distance(otherPosition, member.position) < EXPLOSION_RECURSE_DIST;
+        });
+      if (inRange && world->entityManager.GetObject(otherEntity).type == EntityType::EXPLOSIVE)
       {
-        explodeList.insert(otherActor);
+        ScheduleExplosion(otherEntity, chainDelayTicks);
       }
 
-      // push nearby dynamic objects
-      if (dist < EXPLOSION_MAX_OBJECT_DIST)
+      if (auto* rd = otherActor->is<PxRigidDynamic>())
       {
-        if (auto* rd = otherActor->is<PxRigidDynamic>())
-        {
-          float forceStr = glm::min(EXPLOSION_OBJECT_FORCE / (dist), EXPLOSION_OBJECT_FORCE);
-          glm::vec3 dir = glm::normalize(otherObject.transform.position - explosionCenter);
-          glm::vec3 force = dir * forceStr;
-          rd->addForce(toPxVec3(force), PxForceMode::eVELOCITY_CHANGE);
-        }
+        pushedActors.push_back(rd);
+        pushX.push_back(otherPosition.x);
+        pushY.push_back(otherPosition.y);
+        pushZ.push_back(otherPosition.z);
+      }
+    }
+
+    // push nearby dynamic objects
+    forceX.assign(pushedActors.size(), 0.0f);
+    forceY.assign(pushedActors.size(), 0.0f);
+    forceZ.assign(pushedActors.size(), 0.0f);
+    for (const auto& member : members)
+    {
+      ExplosionFalloff(member.position, EXPLOSION_MAX_OBJECT_DIST, EXPLOSION_OBJECT_FORCE,
+        pushX, pushY, pushZ, forceX, forceY, forceZ);
+    }
+    for (size_t i = 0; i < pushedActors.size(); i++)
+    {
+      if (forceX[i] != 0 || forceY[i] != 0 || forceZ[i] != 0)
+      {
+        pushedActors[i]->addForce(PxVec3(forceX[i], forceY[i], forceZ[i]), PxForceMode::eVELOCITY_CHANGE);
       }
     }
 
     // push the player
-    float dist = glm::distance(world->camera.viewInfo.position, explosionCenter);
-    if (dist < EXPLOSION_MAX_PLAYER_DIST)
-    {
-      float curSpeed = glm::max(glm::length(pVel), 4.0f);
-      float reductionFactor = curSpeed / 4;
-      float forceStr = glm::min(EXPLOSION_PLAYER_FORCE / (dist), EXPLOSION_PLAYER_FORCE);
-      forceStr = glm::max(EXPLOSION_MIN_PLAYER_FORCE, forceStr) / reductionFactor;
-      glm::vec3 dir = glm::normalize(world->camera.viewInfo.position - explosionCenter);
-      glm::vec3 force = dir * forceStr;
-      pVel += force;
-      pVel.y += 6 / (reductionFactor / 2); // small Y factor so first explosion always pushes the player up a bit
-      pExploded = true;
+    const glm::vec3 playerEye = PlayerEyePosition();
+    for (const auto& member : members)
+    {
+      float dist = glm::distance(playerEye, member.position);
+      if (dist < EXPLOSION_MAX_PLAYER_DIST)
+      {
+        float curSpeed = glm::max(glm::length(pVel), 4.0f);
+        float reductionFactor = curSpeed / 4;
+        float forceStr = glm::min(EXPLOSION_PLAYER_FORCE / (dist), EXPLOSION_PLAYER_FORCE);
+        forceStr = glm::max(EXPLOSION_MIN_PLAYER_FORCE, forceStr) / reductionFactor;
+        glm::vec3 dir = glm::normalize(playerEye - member.position);
+        glm::vec3 force = dir * forceStr;
+        pVel += force;
+        pVel.y += 6 / (reductionFactor / 2); // small Y factor so first explosion always pushes the player up a bit
+        pExploded = true;
+      }
     }
 
-    world->entityManager.DestroyEntity(entity);
-    FreeActor(actor);
+    for (const auto& member : members)
+    {
+      world->entityManager.DeferDestroy(member.entity);
+      FreeActor(member.actor);
+    }
   }
 
   Game::collider_t CookMesh(const GFX::Mesh& mesh)
@@ -439,17 +991,21 @@ struct PhysicsImpl
     desc.reportCallback = controllerHitCallback;
 
     controller = gCManager->createController(desc);
-    auto vp = world->camera.viewInfo.position;
-    controller->setPosition({ vp.x, vp.y, vp.z });
+    SetPlayerPos(world->camera.viewInfo.position);
   }
 
-  void SimulatePlayer(float dt)
+  // looking around isn't simulated, so it's applied once per frame
+  void UpdateLook()
   {
-    // mouse controls
     auto& vi = world->camera.viewInfo;
     vi.yaw += world->io->MouseDelta.x * world->mouseSensitivity;
     vi.pitch = glm::clamp(vi.pitch - world->io->MouseDelta.y * world->mouseSensitivity, glm::radians(-89.0f), glm::radians(89.0f));
+  }
 
+  // moves the player by one physics step of length dt
+  void StepPlayer(float dt)
+  {
+    const auto& vi = world->camera.viewInfo;
     const auto fwd = world->camera.viewInfo.GetForwardDir();
     const glm::vec2 xzForward = glm::normalize(glm::vec2(fwd.x, fwd.z));
     const glm::vec2 xzRight = glm::normalize(glm::vec2(-xzForward.y, xzForward.x));
@@ -517,13 +1073,11 @@ struct PhysicsImpl
     //ImGui::Text("Exploded: %d", pExploded);
     //ImGui::End();
 
-    glm::vec3 startPosition = world->camera.viewInfo.position;
-
-    pAccum += dt;
-    float dtFixed = pTick;
-    while (pAccum > pTick)
+    const float dtFixed = dt / playerSubsteps;
+    for (int substep = 0; substep < playerSubsteps; substep++)
     {
-      pAccum -= pTick;
+      const auto& ps = controller->getPosition();
+      const glm::vec3 startPosition{ ps.x, ps.y, ps.z };
 
       pVel.y += gravity * dtFixed;
       glm::vec2 velXZ{ pVel.x, pVel.z };
@@ -592,16 +1146,15 @@ struct PhysicsImpl
         pVel.z = actualVelocity.z;
       }
     }
+  }
 
-    // remove glow from all 
-    for (auto& object : world->entityManager.GetObjects())
-    {
-      if (object.type == EntityType::EXPLOSIVE)
-      {
-        object.renderable.glow = EXPLOSIVE_BASE_GLOW;
-      }
-    }
+  // picking up, highlighting and placing bombs work from what's on screen, so they happen once per frame
+  void UpdateInteraction()
+  {
+    const auto& vi = world->camera.viewInfo;
 
+    // find the explosive we're looking at this frame (if any)
+    Game::entity_t selected{};
     {
       // scene query to see if we're looking at an explosive
       PxQueryFilterData filterData(PxQueryFlag::eDYNAMIC);
@@ -619,29 +1172,47 @@ struct PhysicsImpl
         std::sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) { return a.distance < b.distance; });
         const auto& closest = hits[1];
 
-        if (gActorToEntity.contains(closest.actor))
+        if (auto entity = EntityOf(closest.actor))
         {
-          auto entity = gActorToEntity[closest.actor];
-          auto& obj = GET_OBJ(entity);
+          auto obj = GET_OBJ(entity);
           if (obj.type == EntityType::EXPLOSIVE && world->bombInventory < POCKET_SIZE)
           {
-            obj.renderable.glow = SELECT_GLOW;
+            selected = entity;
 
             if (world->io->KeysDownDuration[GLFW_KEY_E] == 0.0f)
             {
-              RemoveObject(entity);
-              world->entityManager.DestroyEntity(entity);
-              world->bombInventory++;
+              // removing finishes the running step, which may blow the bomb up before it can be picked up
+              if (RemoveObject(entity))
+              {
+                world->entityManager.DeferDestroy(entity);
+                world->bombInventory++;
+              }
+              selected = {};
             }
           }
         }
       }
     }
 
+    // only touch the glow of explosives whose selection state changed
+    if (selected != highlighted)
     {
-      auto& placementObj = GET_OBJ(placementIndicator);
+      if (auto old = world->entityManager.TryGetObject(highlighted))
+      {
+        old->renderable.glow = EXPLOSIVE_BASE_GLOW;
+      }
+      if (selected)
+      {
+        GET_OBJ(selected).renderable.glow = SELECT_GLOW;
+      }
+      highlighted = selected;
+    }
+
+    {
+      auto placementObj = GET_OBJ(placementIndicator);
       placementObj.renderable.visible = false;
       placementObj.transform.position = vi.position + vi.GetForwardDir() * SELECT_DISTANCE;
+      world->entityManager.MarkChanged<Transform>(placementIndicator);
 
       // show bomb outline if holding F
       if (world->io->KeysDown[GLFW_KEY_F] && (world->bombInventory > 0 || world->cheats))
@@ -676,114 +1247,132 @@ struct PhysicsImpl
     }
   }
 
+  // advances the simulation in fixed steps, as many as the time since the last frame covers (up to
+  // MAX_STEPS_PER_FRAME). Whatever time is left over is used to blend the camera and moving objects between the last
+  // two steps, so the render rate and the simulation rate are independent
   void Simulate(float dt)
   {
-    assert(placementIndicator > 0);
+    assert(placementIndicator);
 
     if (controller && world)
     {
-      SimulatePlayer(dt);
-      const auto& p = controller->getPosition();
-      world->camera.viewInfo.position = { p.x, p.y + .4, p.z };
+      UpdateLook();
     }
 
-    // copy OG explode list, then clear it so we can add more stuff to explode in there
-    auto explodeListTemp = explodeList;
-    explodeList.clear();
-    for (auto* actor : explodeListTemp)
+    accumulator = glm::min(accumulator + dt, tick * MAX_STEPS_PER_FRAME);
+    while (accumulator >= tick)
     {
-      Explode(actor);
-
-      // erase self from explode list so it doesn't attempt to blow itself up next frame
-      if (explodeList.contains(actor))
+      if (stepState == StepState::IDLE)
       {
-        explodeList.erase(actor);
+        StartStep();
       }
+      FinishStep();
+      stepState = StepState::IDLE;
+      accumulator -= tick;
+
+      // sync point: apply the destroys (and spawns) recorded by this tick before the next one starts. Not done in
+      // FinishStep itself, since that can also run in the middle of a batch spawn when an object is added
+      world->entityManager.FlushCommands();
     }
 
-    assert(placementIndicator > 0);
+    if (controller && world)
+    {
+      world->camera.viewInfo.position = glm::mix(previousEyePosition, eyePosition, InterpolationAlpha());
+      UpdateInteraction();
+    }
+
+    // picking a bomb up happens outside the tick loop, so its destroy is applied here
+    world->entityManager.FlushCommands();
 
-    bool asdf = false;
-    accumulator += dt;
-    accumulator = glm::min(accumulator, tick * 20); // accumulate 20 steps of backlog
-    if (accumulator > tick) // NOTE: not while loop, because we want to avoid the Well of Despair
+    // get the next step going so it simulates while this frame is rendered
+    if (dt > 0 && stepState == StepState::IDLE)
     {
-      if (resultsReady)
-      {
-        gScene->simulate(tick);
-        resultsReady = false;
-      }
-      if (gScene->fetchResults(false))
-      {
-        resultsReady = true;
-        accumulator -= tick;
-        asdf = true;
+      StartStep();
+    }
 
-        // simulate particles here
-        std::vector<Game::entity_t> deleteList;
-        for (auto& obj : world->entityManager.GetObjects())
-        {
-          if (obj.type == EntityType::PARTICLE)
-          {
-            assert(!gEntityToActor.contains(obj.entity));
-            obj.particle.velocity *= 0.98;
-            obj.particle.velocity += obj.particle.acceleration * (float)tick;
-            obj.transform.position += obj.particle.velocity * (float)tick;
-            obj.particle.life -= tick;
-            if (obj.particle.life < 0)
-            {
-              deleteList.push_back(obj.entity);
-            }
-          }
-        }
+    assert(placementIndicator);
+  }
 
-        for (auto entity : deleteList)
-        {
-          world->entityManager.DestroyEntity(entity);
-        }
-      }
+  void StartStep()
+  {
+    assert(stepState == StepState::IDLE);
+    if (controller && world)
+    {
+      StepPlayer(static_cast<float>(tick));
     }
 
-    assert(placementIndicator > 0);
+    stepCompletion.done.store(false);
+    stepCompletion.setContinuation(*gScene->getTaskManager(), nullptr);
+    gScene->simulate(tick, &stepCompletion);
+    stepCompletion.removeReference();
+    stepState = StepState::RUNNING;
+  }
 
-    if (!asdf)
+  // waits for the running step and applies its results. Does nothing if no step is running
+  void FinishStep()
+  {
+    if (stepState != StepState::RUNNING)
+    {
       return;
+    }
 
-    // update all entity transforms whose actor counterpart was updated
-    const auto actorTypes = PxActorTypeFlag::eRIGID_DYNAMIC | PxActorTypeFlag::eRIGID_STATIC;
-    const auto numActors = gScene->getNbActors(actorTypes);
-    if (numActors > 0)
+    stepCompletion.done.wait(false);
+    gScene->fetchResults(true);
+    stepState = StepState::FINISHED;
+    stepCount++;
+
+    if (controller)
     {
-      std::vector<PxRigidActor*> actors(numActors);
-      gScene->getActors(actorTypes, reinterpret_cast<PxActor**>(actors.data()), numActors);
-      for (auto actor : actors)
-      {
-        const bool sleeping = actor->is<PxRigidDynamic>() ? actor->is<PxRigidDynamic>()->isSleeping() : false;
-        if (sleeping)
-          continue;
-        const auto& pose = actor->getGlobalPose();
+      previousEyePosition = eyePosition;
+      eyePosition = PlayerEyePosition();
+    }
 
-        auto entityIt = gActorToEntity.find(actor);
-        if (entityIt != gActorToEntity.end())
-        {
-          //auto& tr = entityit->second.GetComponent<Component::Transform>();
-          auto* dynamic = actor->is<PxRigidDynamic>();
+    // this has to come before anything that can release actors, since the active actor list isn't updated then
+    SyncActiveTransforms();
 
-          glm::quat q(toGlmQuat(pose.q));
-          auto& object = world->entityManager.GetObject(entityIt->second);
-          object.transform.position = toGlmVec3(pose.p);
-          object.transform.rotation = q;
-        }
+    // explosions triggered by this step's contacts are due now, so they go off before the next step
+    const auto processStart = std::chrono::steady_clock::now();
+    ProcessEvents();
+    eventStats.processSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - processStart).count();
+    ProcessExplosions();
+    physicsTick++;
+
+    world->particles.Update((float)tick, { .eye = eyePosition, .viewProj = world->camera.GetViewProj() }, workers);
+  }
+
+  // how far the current time is from the last step towards the next one, in [0, 1)
+  float InterpolationAlpha() const
+  {
+    return static_cast<float>(accumulator / tick);
+  }
+
+  // copies the poses of the actors that moved in the last step to their entities. PhysX only reports awake dynamic
+  // actors, so static platforms and sleeping objects cost nothing
+  void SyncActiveTransforms()
+  {
+    PxU32 count = 0;
+    PxActor** actors = gScene->getActiveActors(count);
+    for (PxU32 i = 0; i < count; i++)
+    {
+      // the player's controller has an actor too, but no entity
+      const auto entity = EntityOf(actors[i]);
+      if (!entity)
+      {
+        continue;
       }
-    }
 
-    assert(placementIndicator > 0);
+      const PxTransform pose = static_cast<PxRigidActor*>(actors[i])->getGlobalPose();
+      auto& transform = world->entityManager.Write<Transform>(entity);
+      world->entityManager.Get<PreviousPose>(entity) = { transform.position, transform.rotation, stepCount };
+      transform.position = toGlmVec3(pose.p);
+      transform.rotation = toGlmQuat(pose.q);
+    }
   }
 
   void AddObject(Game::entity_t entity, Game::MaterialType material, Game::collider_t mesh)
   {
     assert(0 && "This function doesn't work!");
-    auto& object = GET_OBJ(entity);
+    auto object = GET_OBJ(entity);
     PxTriangleMeshGeometry geom(reinterpret_cast<PxTriangleMesh*>(mesh));
     geom.scale.scale = toPxVec3(object.transform.scale);
     geom.scale.rotation = toPxQuat({ 1, 0, 0, 0 });
@@ -809,15 +1398,16 @@ struct PhysicsImpl
       break;
     }
 
-    gActorToEntity[actor] = entity;
-    gEntityToActor[entity] = actor;
+    LinkActor(actor, entity);
 
     gScene->addActor(*actor);
   }
 
   void AddObject(Game::entity_t entity, Game::MaterialType material, const Game::Shape* shape)
   {
-    Game::GameObject& object = world->entityManager.GetObject(entity);
+    // the scene can't be modified while a step is running, so it's finished early
+    FinishStep();
+    Game::GameObject object = world->entityManager.GetObject(entity);
     auto pose = PxTransform(toPxVec3(object.transform.position), toPxQuat(object.transform.rotation));
 
     PxGeometry* geom;
@@ -860,34 +1450,37 @@ struct PhysicsImpl
     }
 
 
-    gActorToEntity[actor] = entity;
-    gEntityToActor[entity] = actor;
+    SetFilterCategory(actor, object.type == EntityType::EXPLOSIVE ? FILTER_EXPLOSIVE :
+      material == Game::MaterialType::TERRAIN ? FILTER_TERRAIN : FILTER_PROP);
+    LinkActor(actor, entity);
 
     gScene->addActor(*actor);
   }
 
-  void RemoveObject(Game::entity_t entity)
+  // returns false if the entity had no actor, e.g. because the step finished here just exploded it
+  bool RemoveObject(Game::entity_t entity)
   {
-    if (entity)
+    FinishStep();
+    if (auto* actor = ActorOf(entity))
     {
-      auto actor = gEntityToActor[entity];
-      gEntityToActor.erase(entity);
-      gActorToEntity.erase(actor);
-      gScene->removeActor(*actor);
+      FreeActor(actor);
+      return true;
     }
+    return false;
   }
 
   void SetObjectTransform(Game::entity_t object, Transform transform)
   {
-    gEntityToActor[object]->setGlobalPose({ toPxVec3(transform.position), toPxQuat(transform.rotation) });
+    FinishStep();
+    ActorOf(object)->setGlobalPose({ toPxVec3(transform.position), toPxQuat(transform.rotation) });
   }
 };
 
 namespace Game
 {
-  Physics::Physics()
+  Physics::Physics(ThreadPool& workers)
   {
-    impl_ = new PhysicsImpl;
+    impl_ = new PhysicsImpl(workers);
     impl_->physics = this;
   }
 
@@ -911,6 +1504,26 @@ namespace Game
     impl_->Simulate(dt);
   }
 
+  float Physics::InterpolationAlpha() const
+  {
+    return impl_->InterpolationAlpha();
+  }
+
+  uint32_t Physics::LastStep() const
+  {
+    return impl_->stepCount;
+  }
+
+  Physics::EventStats Physics::GetEventStats() const
+  {
+    return impl_->eventStats;
+  }
+
+  void Physics::DrawMemoryStats()
+  {
+    impl_->DrawMemoryStats();
+  }
+
   void Physics::SetPlayerPos(glm::vec3 pos)
   {
     impl_->SetPlayerPos(pos);
@@ -921,6 +1534,16 @@ namespace Game
     impl_->Reset();
   }
 
+  void Physics::SaveSnapshot()
+  {
+    impl_->SaveSnapshot();
+  }
+
+  void Physics::RestoreSnapshot()
+  {
+    impl_->RestoreSnapshot();
+  }
+
   //void Physics::AddObject(entity_t object, MaterialType material, collider_t mesh)
   //{
   //  impl_->AddObject(object, material, mesh);
@@ -946,68 +1569,30 @@ void ContactReportCallback::onConstraintBreak(PxConstraintInfo* constraints, PxU
   //printf("a");
 }
 
-void ContactReportCallback::onContact(const PxContactPairHeader& pairHeader, [[maybe_unused]] const PxContactPair* pairs, [[maybe_unused]] PxU32 nbPairs)
+void ContactReportCallback::onContact(const PxContactPairHeader& pairHeader, const PxContactPair* pairs, PxU32 nbPairs)
 {
-  auto* a = pairHeader.actors[0];
-  auto* b = pairHeader.actors[1];
-  auto it1 = physics_->gActorToEntity.find(a);
-  auto it2 = physics_->gActorToEntity.find(b);
-
-  // explode explosives on contact with lava
-  if (it1 == physics_->gActorToEntity.end() && it2 != physics_->gActorToEntity.end())
+  // deleted actors can't be looked at
+  if (pairHeader.flags & (PxContactPairHeaderFlag::eREMOVED_ACTOR_0 | PxContactPairHeaderFlag::eREMOVED_ACTOR_1))
   {
-    PxShape* shape;
-    if (a && a->getShapes(&shape, 1) && a->getNbShapes() == 1)
-    {
-      auto type = physics_->world->entityManager.GetObject(it2->second).type;
-      if (shape->getGeometryType() == PxGeometryType::ePLANE && type == EntityType::EXPLOSIVE)
-      {
-        physics_->explodeList.insert(b);
-      }
-    }
-  }
-  if (it2 == physics_->gActorToEntity.end() && it1 != physics_->gActorToEntity.end())
-  {
-    PxShape* shape;
-    if (b && b->getShapes(&shape, 1) && b->getNbShapes() == 1)
-    {
-      auto type = physics_->world->entityManager.GetObject(it1->second).type;
-      if (shape->getGeometryType() == PxGeometryType::ePLANE && type == EntityType::EXPLOSIVE)
-      {
-        physics_->explodeList.insert(a);
-      }
-    }
+    return;
   }
 
-  for (int i = 0; i < nbPairs; i++)
+  // the filter shader only asks for reports that set off an explosive: being hit hard enough, or touching lava
+  physics_->eventStats.contactPairs += nbPairs;
+  for (PxU32 i = 0; i < nbPairs; i++)
   {
     const auto& pair = pairs[i];
-
-    for (int j = 0; j < pair.contactCount; j++)
+    if (!(pair.events & (PxPairFlag::eNOTIFY_TOUCH_FOUND | PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND)))
     {
+      continue;
+    }
 
-      // contact where the explosion threshold wasn't reached
-      if (!(pair.events & PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND))
-      {
-        continue;
-      }
-
-      if (auto ait = physics_->gActorToEntity.find(a); ait != physics_->gActorToEntity.end())
-      {
-        auto type = physics_->world->entityManager.GetObject(ait->second).type;
-        if (type == EntityType::EXPLOSIVE)
-        {
-          physics_->explodeList.insert(a);
-        }
-      }
-
-      if (auto bit = physics_->gActorToEntity.find(b); bit != physics_->gActorToEntity.end())
+    for (int k = 0; k < 2; k++)
+    {
+      if (pair.shapes[k]->getSimulationFilterData().word0 & FILTER_EXPLOSIVE)
       {
-        auto type = physics_->world->entityManager.GetObject(bit->second).type;
-        if (type == EntityType::EXPLOSIVE)
-        {
-          physics_->explodeList.insert(b);
-        }
+        physics_->events.TryPush({ .type = PhysicsImpl::PhysicsEvent::Type::EXPLOSIVE_HIT,
+          .entity = PhysicsImpl::EntityOf(pairHeader.actors[k]) });
       }
     }
   }
@@ -1015,35 +1600,15 @@ void ContactReportCallback::onContact(const PxContactPairHeader& pairHeader, [[m
 
 void UserControllerHitReport::onShapeHit(const PxControllerShapeHit& hit)
 {
-  if (hit.actor && impl_->gActorToEntity.contains(hit.actor))
+  using Type = PhysicsImpl::PhysicsEvent::Type;
+  if (const auto entity = PhysicsImpl::EntityOf(hit.actor))
   {
-    const auto ent = impl_->gActorToEntity[hit.actor];
-    const auto& obj = impl_->world->entityManager.GetObject(ent);
-
-    if (obj.physics.isWinPlatform)
-    {
-      impl_->world->gameState = GameState::WIN_LEVEL;
-    }
-
-    if (obj.type == EntityType::EXPLOSIVE && glm::length(impl_->pVel) > EXPLOSION_PLAYER_TRIGGER_FORCE)
-    {
-      impl_->explodeList.insert(hit.actor);
-    }
+    impl_->events.TryPush({ .type = Type::PLAYER_HIT_OBJECT, .entity = entity, .playerSpeed = glm::length(impl_->pVel) });
   }
 
-  // only the lava plane doesn't have an actor, so we use this hack to detect if we hit it
-  PxShape* shape;
-  if (hit.actor && !impl_->gActorToEntity.contains(hit.actor))
+  // touching lava kills the player
+  if (hit.shape && (hit.shape->getSimulationFilterData().word0 & FILTER_LAVA))
   {
-    hit.actor->getShapes(&shape, 1);
-    if (shape->getGeometryType() == PxGeometryType::ePLANE);
-    {
-      // cheaters are invincible
-      if (!impl_->world->cheats)
-      {
-        impl_->world->deathCounter++;
-        impl_->world->gameState = GameState::DEAD;
-      }
-    }
+    impl_->events.TryPush({ .type = Type::PLAYER_HIT_LAVA });
   }
 }
\ No newline at end of file
@@ -9,6 +9,7 @@ struct PhysicsImpl;
 struct Transform;
 
 struct World;
+class ThreadPool;
 
 namespace GFX
 {
@@ -39,7 +40,8 @@ namespace Game
   class Physics
   {
   public:
-    Physics();
+    // PhysX runs its tasks on the given workers, which must outlive this
+    explicit Physics(ThreadPool& workers);
     ~Physics();
 
     NOCOPY_NOMOVE(Physics)
@@ -49,8 +51,29 @@ namespace Game
     void Simulate(float dt);
     void SetPlayerPos(glm::vec3 pos);
 
+    // rendering blends from each moved entity's PreviousPose to its Transform by this much, but only for entities
+    // whose PreviousPose::step is LastStep(). Anything else hasn't moved since the step before and is drawn as is
+    float InterpolationAlpha() const;
+    uint32_t LastStep() const;
+
+    // window with what PhysX has allocated, broken down by the type names PhysX reports
+    void DrawMemoryStats();
+
+    // totals since startup, for the benchmarks
+    struct EventStats
+    {
+      uint64_t contactPairs{};   // pairs handed to the contact report callback
+      uint64_t events{};         // contact and controller events processed after steps
+      double processSeconds{};   // time spent in processing them
+    };
+    EventStats GetEventStats() const;
+
     void Reset();
 
+    // saves the pose and velocity of every actor so RestoreSnapshot() can put the scene back without recreating them
+    void SaveSnapshot();
+    void RestoreSnapshot();
+
     //void AddObject(GameObject* object, MaterialType material, collider_t mesh);
     void AddObject(entity_t entity, MaterialType material, const Shape* shape);
     void RemoveObject(entity_t entity);
@@ -0,0 +1,352 @@
+#include "physics_allocator.h"
+
+#include <new>
+#include <bit>
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+  constexpr std::align_val_t ALIGNMENT{ 16 };
+
+  void UpdatePeak(std::atomic<size_t>& peak, size_t value)
+  {
+    size_t previous = peak.load(std::memory_order_relaxed);
+    while (previous < value && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  // fibonacci hashing, since string literals are aligned and the low bits of their addresses say little
+  template<size_t Bits>
+  size_t HashPointer(const void* pointer)
+  {
+    return static_cast<size_t>((uint64_t(reinterpret_cast<uintptr_t>(pointer)) * 0x9E3779B97F4A7C15ull) >> (64 - Bits));
+  }
+}
+
+PhysicsAllocator::PhysicsAllocator()
+{
+  // index 0 catches allocations made without a name
+  typeNames_[0] = "(unnamed)";
+  typesByName_.emplace(typeNames_[0], uint16_t(0));
+  typeCount_.store(1);
+}
+
+PhysicsAllocator::~PhysicsAllocator()
+{
+  // PhysX is gone by now, so anything still allocated was leaked by it and is released with the pages
+  for (size_t c = 0; c < CLASS_COUNT; c++)
+  {
+    for (void* page : pools_[c].pages)
+    {
+      ::operator delete(page, ALIGNMENT);
+    }
+  }
+  for (ArenaBlock* block : { arena_, spareArena_ })
+  {
+    if (block)
+    {
+      ::operator delete(block->data, ALIGNMENT);
+      delete block;
+    }
+  }
+}
+
+void* PhysicsAllocator::allocate(size_t size, const char* typeName, const char*, int)
+{
+  const size_t total = size + sizeof(Header);
+  Header header
+  {
+    .size = static_cast<uint32_t>(size),
+    .type = TypeIndex(typeName),
+    .source = HEAP,
+    .sizeClass = 0,
+    .block = nullptr,
+  };
+
+  TypeCounters& type = types_[header.type];
+  void* memory = nullptr;
+  if (total <= MAX_CLASS_SIZE)
+  {
+    if (levelLoading_.load(std::memory_order_relaxed) && !type.outlivesLevel.load(std::memory_order_relaxed))
+    {
+      std::scoped_lock lock(arenaMutex_);
+      if (levelLoading_.load(std::memory_order_relaxed))
+      {
+        memory = AllocateFromArena(total, header.block);
+        header.source = ARENA;
+        type.arenaLive.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (!memory)
+    {
+      // the smallest class that fits: 32 bytes is class 0, and every class doubles
+      header.sizeClass = static_cast<uint8_t>(std::max<size_t>(std::bit_width(total - 1), 5) - 5);
+      header.source = POOL;
+      memory = AllocateFromPool(header.sizeClass);
+    }
+  }
+  else
+  {
+    memory = AllocateFromHeap(total);
+  }
+
+  *static_cast<Header*>(memory) = header;
+
+  UpdatePeak(type.peakBytes, type.liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+  type.liveCount.fetch_add(1, std::memory_order_relaxed);
+  type.allocations.fetch_add(1, std::memory_order_relaxed);
+  UpdatePeak(peakBytes_, liveBytes_.fetch_add(size, std::memory_order_relaxed) + size);
+
+  return static_cast<Header*>(memory) + 1;
+}
+
+void PhysicsAllocator::deallocate(void* ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+
+  Header* header = static_cast<Header*>(ptr) - 1;
+  TypeCounters& type = types_[header->type];
+  type.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+  type.liveCount.fetch_sub(1, std::memory_order_relaxed);
+  liveBytes_.fetch_sub(header->size, std::memory_order_relaxed);
+
+  switch (header->source)
+  {
+  case POOL:
+  {
+    Pool& pool = pools_[header->sizeClass];
+    std::scoped_lock lock(pool.mutex);
+    *reinterpret_cast<void**>(header) = pool.freeList;
+    pool.freeList = header;
+    break;
+  }
+  case ARENA:
+  {
+    type.arenaLive.fetch_sub(1, std::memory_order_relaxed);
+    std::scoped_lock lock(arenaMutex_);
+    ArenaBlock* block = header->block;
+    if (--block->live == 0 && block->retired)
+    {
+      ReleaseArenaBlock(block);
+    }
+    break;
+  }
+  case HEAP:
+    FreeToHeap(header, header->size + sizeof(Header));
+    break;
+  }
+}
+
+void PhysicsAllocator::BeginLevel()
+{
+  std::scoped_lock lock(arenaMutex_);
+
+  // the previous level is gone, so whatever is still in its arena belongs to the scene or to PhysX itself. Those
+  // types would pin a block on every load, so they go to the pools from now on
+  const size_t count = typeCount_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (types_[i].arenaLive.load(std::memory_order_relaxed) > 0)
+    {
+      types_[i].outlivesLevel.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  levelLoading_.store(true, std::memory_order_relaxed);
+  if (arena_ && arena_->live == 0)
+  {
+    arena_->used = 0; // everything from the last level is gone, so its block can be reused as is
+    return;
+  }
+  if (arena_)
+  {
+    arena_->retired = true;
+    arena_ = nullptr;
+  }
+}
+
+void PhysicsAllocator::EndLevel()
+{
+  std::scoped_lock lock(arenaMutex_);
+  levelLoading_.store(false, std::memory_order_relaxed);
+}
+
+void PhysicsAllocator::GetStats(Stats& stats) const
+{
+  stats.liveBytes = liveBytes_.load(std::memory_order_relaxed);
+  stats.peakBytes = peakBytes_.load(std::memory_order_relaxed);
+  stats.reservedBytes = reservedBytes_.load(std::memory_order_relaxed);
+  stats.heapAllocations = heapAllocations_.load(std::memory_order_relaxed);
+  stats.arenaBlocks = arenaBlocks_.load(std::memory_order_relaxed);
+
+  // names are written before the count is bumped, so every name below the count is complete
+  const size_t count = typeCount_.load(std::memory_order_acquire);
+  stats.types.resize(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    const TypeCounters& type = types_[i];
+    stats.types[i] =
+    {
+      .name = typeNames_[i],
+      .liveBytes = type.liveBytes.load(std::memory_order_relaxed),
+      .peakBytes = type.peakBytes.load(std::memory_order_relaxed),
+      .liveCount = type.liveCount.load(std::memory_order_relaxed),
+      .allocations = type.allocations.load(std::memory_order_relaxed),
+    };
+  }
+}
+
+void* PhysicsAllocator::AllocateFromPool(size_t sizeClass)
+{
+  Pool& pool = pools_[sizeClass];
+  std::scoped_lock lock(pool.mutex);
+  if (!pool.freeList)
+  {
+    // carve a new page into slots and thread them all onto the free list
+    const size_t slotSize = MIN_CLASS_SIZE << sizeClass;
+    std::byte* page = static_cast<std::byte*>(AllocateFromHeap(POOL_PAGE_SIZE));
+    pool.pages.push_back(page);
+    for (size_t offset = POOL_PAGE_SIZE; offset >= slotSize; offset -= slotSize)
+    {
+      void* slot = page + offset - slotSize;
+      *static_cast<void**>(slot) = pool.freeList;
+      pool.freeList = slot;
+    }
+  }
+
+  void* slot = pool.freeList;
+  pool.freeList = *static_cast<void**>(slot);
+  return slot;
+}
+
+void* PhysicsAllocator::AllocateFromArena(size_t size, ArenaBlock*& block)
+{
+  size = (size + 15) & ~size_t(15);
+  if (arena_ && arena_->used + size > ARENA_BLOCK_SIZE)
+  {
+    arena_->retired = true;
+    if (arena_->live == 0)
+    {
+      ReleaseArenaBlock(arena_);
+    }
+    arena_ = nullptr;
+  }
+  if (!arena_)
+  {
+    arena_ = NewArenaBlock();
+  }
+
+  void* memory = arena_->data + arena_->used;
+  arena_->used += size;
+  arena_->live++;
+  block = arena_;
+  return memory;
+}
+
+PhysicsAllocator::ArenaBlock* PhysicsAllocator::NewArenaBlock()
+{
+  if (ArenaBlock* block = std::exchange(spareArena_, nullptr))
+  {
+    return block;
+  }
+
+  arenaBlocks_.fetch_add(1, std::memory_order_relaxed);
+  ArenaBlock* block = new ArenaBlock;
+  block->data = static_cast<std::byte*>(AllocateFromHeap(ARENA_BLOCK_SIZE));
+  return block;
+}
+
+void PhysicsAllocator::ReleaseArenaBlock(ArenaBlock* block)
+{
+  // one empty block is kept so loading the next level doesn't go to the heap
+  if (!spareArena_)
+  {
+    *block = { .data = block->data };
+    spareArena_ = block;
+    return;
+  }
+
+  arenaBlocks_.fetch_sub(1, std::memory_order_relaxed);
+  FreeToHeap(block->data, ARENA_BLOCK_SIZE);
+  delete block;
+}
+
+void* PhysicsAllocator::AllocateFromHeap(size_t size)
+{
+  reservedBytes_.fetch_add(size, std::memory_order_relaxed);
+  heapAllocations_.fetch_add(1, std::memory_order_relaxed);
+  return ::operator new(size, ALIGNMENT);
+}
+
+void PhysicsAllocator::FreeToHeap(void* memory, size_t size)
+{
+  reservedBytes_.fetch_sub(size, std::memory_order_relaxed);
+  ::operator delete(memory, ALIGNMENT);
+}
+
+uint16_t PhysicsAllocator::TypeIndex(const char* typeName)
+{
+  if (!typeName)
+  {
+    return 0;
+  }
+
+  constexpr size_t MASK = (size_t(1) << TYPE_SLOT_BITS) - 1;
+  const size_t home = HashPointer<TYPE_SLOT_BITS>(typeName);
+  for (size_t probe = 0; probe <= MASK; probe++)
+  {
+    const TypeSlot& slot = typeSlots_[(home + probe) & MASK];
+    const char* name = slot.name.load(std::memory_order_acquire);
+    if (name == typeName)
+    {
+      return slot.index.load(std::memory_order_relaxed);
+    }
+    if (!name)
+    {
+      break;
+    }
+  }
+
+  // first time this pointer is seen. The same name can come from different string literals
+  std::scoped_lock lock(typesMutex_);
+  uint16_t index;
+  if (auto it = typesByName_.find(std::string_view(typeName)); it != typesByName_.end())
+  {
+    index = it->second;
+  }
+  else if (const size_t count = typeCount_.load(std::memory_order_relaxed); count < MAX_TYPES)
+  {
+    index = static_cast<uint16_t>(count);
+    typeNames_[index] = count + 1 < MAX_TYPES ? typeName : "(other)";
+    typesByName_.emplace(typeNames_[index], index);
+    typeCount_.store(count + 1, std::memory_order_release);
+  }
+  else
+  {
+    index = MAX_TYPES - 1;
+  }
+
+  // another thread may have added the pointer while this one waited. If the table is full, the pointer is looked up
+  // by name every time, which is slow but still right
+  for (size_t probe = 0; probe <= MASK; probe++)
+  {
+    TypeSlot& slot = typeSlots_[(home + probe) & MASK];
+    const char* name = slot.name.load(std::memory_order_relaxed);
+    if (name == typeName)
+    {
+      break;
+    }
+    if (!name)
+    {
+      slot.index.store(index, std::memory_order_relaxed);
+      slot.name.store(typeName, std::memory_order_release);
+      break;
+    }
+  }
+  return index;
+}
\ No newline at end of file
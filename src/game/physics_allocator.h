@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// same hack as physics.cpp, PhysX wants exactly one of NDEBUG and _DEBUG
+#if !NDEBUG
+  #define _DEBUG
+#endif
+
+#include <PhysX/pxshared/include/foundation/PxAllocatorCallback.h>
+
+#include "macros.h"
+#include "utility/transparent_string_hash.h"
+
+// allocator for PhysX that keeps it off the system heap in steady state, and counts what it allocates by type name.
+// Small allocations come from size-class pools whose freed slots are reused, so actors being created and released
+// all the time doesn't hit the heap. While a level loads, they're carved from that level's arena instead, which is
+// recycled as a whole once everything in it has been freed. Types that turn out to outlive their level (PhysX's own
+// object pools and scene buffers) are kept out of later arenas, so they can't pin a new block on every load.
+// Anything bigger than the largest class goes to the heap
+class PhysicsAllocator : public physx::PxAllocatorCallback
+{
+public:
+  PhysicsAllocator();
+  ~PhysicsAllocator();
+
+  NOCOPY_NOMOVE(PhysicsAllocator)
+
+  void* allocate(size_t size, const char* typeName, const char* filename, int line) override;
+  void deallocate(void* ptr) override;
+
+  // small allocations made between these are put in a fresh level arena. The previous level's arena is released
+  // (or reused) as soon as its last allocation is freed. Call BeginLevel after the previous level has been released
+  void BeginLevel();
+  void EndLevel();
+
+  struct TypeStats
+  {
+    std::string_view name;
+    size_t liveBytes{};
+    size_t peakBytes{};
+    size_t liveCount{};
+    uint64_t allocations{}; // total since startup. Types are never removed, so rates can be taken from the difference
+  };
+
+  struct Stats
+  {
+    size_t liveBytes{};
+    size_t peakBytes{};
+    size_t reservedBytes{};   // pool pages, arena blocks and large allocations currently held from the system heap
+    uint64_t heapAllocations{}; // total number of times the system heap was called, the churn this is meant to avoid
+    size_t arenaBlocks{};       // level arena blocks held, the spare included. Shouldn't grow as levels are reloaded
+    std::vector<TypeStats> types; // in the order the types were first seen
+  };
+
+  // snapshot of the counters, safe to take while PhysX is allocating on other threads
+  void GetStats(Stats& stats) const;
+
+private:
+  struct ArenaBlock;
+
+  // sits in front of every allocation. Keeps the returned memory 16-byte aligned, as PhysX requires
+  struct alignas(16) Header
+  {
+    uint32_t size;      // requested size
+    uint16_t type;      // index into types_
+    uint8_t source;     // Source
+    uint8_t sizeClass;  // pool the slot came from, when source is POOL
+    ArenaBlock* block;  // arena block the allocation is in, when source is ARENA
+  };
+  static_assert(sizeof(Header) == 16);
+
+  enum Source : uint8_t
+  {
+    POOL,
+    ARENA,
+    HEAP,
+  };
+
+  // slot sizes, header included
+  static constexpr size_t MIN_CLASS_SIZE = 32;
+  static constexpr size_t CLASS_COUNT = 8; // 32 bytes to 4 KiB
+  static constexpr size_t MAX_CLASS_SIZE = MIN_CLASS_SIZE << (CLASS_COUNT - 1);
+  static constexpr size_t POOL_PAGE_SIZE = 64 * 1024;
+  static constexpr size_t ARENA_BLOCK_SIZE = 1024 * 1024;
+
+  struct Pool
+  {
+    std::mutex mutex;
+    void* freeList{}; // free slots point to the next free slot
+    std::vector<void*> pages;
+  };
+
+  struct ArenaBlock
+  {
+    std::byte* data{};
+    size_t used{};
+    size_t live{}; // allocations in the block that haven't been freed
+    bool retired{}; // no longer allocated from, so it can go once live reaches zero
+  };
+
+  static constexpr size_t MAX_TYPES = 512; // types past this are all counted in the last one
+
+  struct TypeCounters
+  {
+    std::atomic<size_t> liveBytes{};
+    std::atomic<size_t> peakBytes{};
+    std::atomic<size_t> liveCount{};
+    std::atomic<uint64_t> allocations{};
+    std::atomic<size_t> arenaLive{};       // allocations of this type in a level arena
+    std::atomic<bool> outlivesLevel{};     // some survived into the next level, so the type stays out of arenas
+  };
+
+  // slot in the lookup table from name pointers to type indices
+  struct TypeSlot
+  {
+    std::atomic<const char*> name{};
+    std::atomic<uint16_t> index{};
+  };
+
+  void* AllocateFromPool(size_t sizeClass);
+  void* AllocateFromArena(size_t size, ArenaBlock*& block);
+  ArenaBlock* NewArenaBlock();
+  void ReleaseArenaBlock(ArenaBlock* block);
+  void* AllocateFromHeap(size_t size);
+  void FreeToHeap(void* memory, size_t size);
+  uint16_t TypeIndex(const char* typeName);
+
+  std::array<Pool, CLASS_COUNT> pools_;
+
+  std::mutex arenaMutex_;
+  std::atomic<bool> levelLoading_{}; // only changed on the main thread while PhysX isn't simulating
+  ArenaBlock* arena_{}; // block being allocated from while a level loads
+  ArenaBlock* spareArena_{}; // emptied block kept around for the next level
+
+  // PhysX passes the same string literals over and over, so indices are looked up by pointer without locking.
+  // Slots are only filled in, under the mutex, with the index stored before the name. The mutex is only taken for
+  // pointers that haven't been seen yet
+  static constexpr size_t TYPE_SLOT_BITS = 11;
+  std::array<TypeSlot, size_t(1) << TYPE_SLOT_BITS> typeSlots_;
+  std::mutex typesMutex_;
+  std::unordered_map<std::string, uint16_t, string_hash, std::equal_to<>> typesByName_;
+  std::array<std::string, MAX_TYPES> typeNames_;
+  std::atomic<size_t> typeCount_{};
+  std::array<TypeCounters, MAX_TYPES> types_;
+
+  std::atomic<size_t> liveBytes_{};
+  std::atomic<size_t> peakBytes_{};
+  std::atomic<size_t> reservedBytes_{};
+  std::atomic<uint64_t> heapAllocations_{};
+  std::atomic<size_t> arenaBlocks_{};
+};
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <format>
 #include <concepts>
 #include <atomic>
+#include <algorithm>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -113,7 +114,11 @@ namespace GFX
     Shader basicShader{};
     Shader standardShader{};
     Shader environmentShader{};
+    Shader particleShader{};
     std::vector<RenderTuple> renderables;
+    std::vector<ParticleInstance> particles;
+    GLuint particleBuffer{};
+    size_t particleBufferCapacity{}; // in particles
     glm::vec3 sunDir = { 0, -1, 0 };
     float blendDay = 0;
     double gTime = 0;
@@ -142,6 +147,7 @@ namespace GFX
       basicShader = LoadVertexFragmentProgram("basic.vert.glsl", "basic.frag.glsl");
       standardShader = LoadVertexFragmentProgram("standard.vert.glsl", "standard.frag.glsl");
       environmentShader = LoadVertexFragmentProgram("environment.vert.glsl", "environment.frag.glsl");
+      particleShader = LoadVertexFragmentProgram("particle.vert.glsl", "particle.frag.glsl");
 
 #if !NDEBUG
       // enable debugging stuff
@@ -158,6 +164,7 @@ namespace GFX
     {
       glDeleteVertexArrays(1, &emptyVao);
       glDeleteVertexArrays(1, &standardVao);
+      glDeleteBuffers(1, &particleBuffer);
       // everything else is leaked because this class is instantiated once and destroyed when the program terminates
     }
 
@@ -217,10 +224,17 @@ namespace GFX
       glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
 
-    void BeginDraw(uint32_t numObjects)
+    void BeginDraw(uint32_t numObjects, uint32_t numParticles)
     {
       drawIndex.store(0);
       renderables.resize(numObjects);
+      particles.clear();
+      particles.reserve(numParticles);
+    }
+
+    void SubmitParticle(const ParticleInstance& particle)
+    {
+      particles.push_back(particle);
     }
 
     void Submit(const Transform& transform,
@@ -231,6 +245,14 @@ namespace GFX
       renderables[myIndex] = { transform.GetModel(), mesh, renderable };
     }
 
+    void Submit(const glm::mat4& model,
+      const MeshHandle& mesh,
+      const Renderable& renderable)
+    {
+      uint32_t myIndex = drawIndex.fetch_add(1);
+      renderables[myIndex] = { model, mesh, renderable };
+    }
+
     void EndDraw(const Camera& camera, float dt)
     {
       gTime += dt;
@@ -238,6 +260,7 @@ namespace GFX
       glEnable(GL_FRAMEBUFFER_SRGB);
 
       DrawRenderables(camera);
+      DrawParticles(camera);
       DrawEnvironment(camera);
 
       sunDir.y = -glm::sin(gTime / 10);
@@ -274,6 +297,35 @@ namespace GFX
       renderables.clear();
     }
 
+    void DrawParticles(const Camera& camera)
+    {
+      if (particles.empty())
+      {
+        return;
+      }
+
+      // the buffer only grows, so uploading is a single sub data call most frames
+      if (particles.size() > particleBufferCapacity)
+      {
+        glDeleteBuffers(1, &particleBuffer);
+        particleBufferCapacity = std::max(particles.size(), particleBufferCapacity * 2);
+        glCreateBuffers(1, &particleBuffer);
+        glNamedBufferStorage(particleBuffer, sizeof(ParticleInstance) * particleBufferCapacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+      }
+      glNamedBufferSubData(particleBuffer, 0, sizeof(ParticleInstance) * particles.size(), particles.data());
+
+      const glm::mat4 view = camera.viewInfo.GetViewMatrix();
+      particleShader.Bind();
+      particleShader.SetMat4("u_viewProj", camera.GetViewProj());
+      particleShader.SetVec3("u_viewPos", camera.viewInfo.position);
+      particleShader.SetVec3("u_viewUp", glm::vec3(view[0][1], view[1][1], view[2][1]));
+      particleShader.SetVec3("u_sunDir", sunDir);
+      particleShader.SetFloat("u_blendDay", blendDay);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particleBuffer);
+      glBindVertexArray(emptyVao);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(particles.size()));
+    }
+
     void DrawEnvironment(const Camera& camera)
     {
       environmentShader.Bind();
@@ -312,9 +364,9 @@ namespace GFX
     return handle;
   }
 
-  void Renderer::BeginDraw(uint32_t numObjects)
+  void Renderer::BeginDraw(uint32_t numObjects, uint32_t numParticles)
   {
-    impl_->BeginDraw(numObjects);
+    impl_->BeginDraw(numObjects, numParticles);
   }
 
   void Renderer::Submit(const Transform& transform,
@@ -324,6 +376,18 @@ namespace GFX
     impl_->Submit(transform, mesh, renderable);
   }
 
+  void Renderer::Submit(const glm::mat4& model,
+    const MeshHandle& mesh,
+    const Renderable& renderable)
+  {
+    impl_->Submit(model, mesh, renderable);
+  }
+
+  void Renderer::SubmitParticle(const ParticleInstance& particle)
+  {
+    impl_->SubmitParticle(particle);
+  }
+
   void Renderer::EndDraw(const Camera& camera, float dt)
   {
     impl_->EndDraw(camera, dt);
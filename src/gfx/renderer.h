@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <glm/fwd.hpp>
+#include <glm/vec3.hpp>
 #include "macros.h"
 
 struct Transform;
@@ -12,6 +14,15 @@ namespace GFX
   struct Camera;
   struct Mesh;
 
+  // per-particle data, laid out to match the instance buffer of the particle shader
+  struct ParticleInstance
+  {
+    glm::vec3 position;
+    float radius;
+    glm::vec3 glow;
+    float _padding{};
+  };
+
   class Renderer
   {
   public:
@@ -22,10 +33,18 @@ namespace GFX
 
     [[nodiscard]] MeshHandle GenerateMeshHandle(const Mesh& mesh);
 
-    void BeginDraw(uint32_t numObjects);
+    void BeginDraw(uint32_t numObjects, uint32_t numParticles = 0);
     void Submit(const Transform& transform,
       const MeshHandle& mesh,
       const Renderable& renderable);
+
+    // for callers that cache the model matrix instead of rebuilding it from a Transform every frame
+    void Submit(const glm::mat4& model,
+      const MeshHandle& mesh,
+      const Renderable& renderable);
+
+    // particles are drawn as camera-facing sphere impostors, all in one instanced draw
+    void SubmitParticle(const ParticleInstance& particle);
     void EndDraw(const Camera& camera, float dt);
 
   private:
@@ -2,7 +2,9 @@
 #include <format>
 #include <stdexcept>
 #include <algorithm>
-#include <execution>
+#include <vector>
+#include <string_view>
+#include <charconv>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -23,6 +25,7 @@
 #include "game/game.h"
 #include "game/physics.h"
 #include "world.h"
+#include "utility/thread_pool.h"
 
 struct WindowCreateInfo
 {
@@ -75,8 +78,53 @@ void InitOpenGL()
   }
 }
 
-int main()
+// worker pool settings from the command line: --threads=N starts N workers besides the main thread, and
+// --affinity=0,2,4 pins them to those CPUs in turn
+struct WorkerConfig
 {
+  size_t threadCount = ThreadPool::DefaultThreadCount();
+  std::vector<uint32_t> affinity;
+};
+
+WorkerConfig ParseWorkerConfig(int argc, char** argv)
+{
+  WorkerConfig config;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--threads="))
+    {
+      arg.remove_prefix(sizeof("--threads=") - 1);
+      auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), config.threadCount);
+      if (error != std::errc{} || end != arg.data() + arg.size())
+      {
+        throw std::runtime_error(std::format("Invalid thread count in {}", argv[i]));
+      }
+    }
+    else if (arg.starts_with("--affinity="))
+    {
+      arg.remove_prefix(sizeof("--affinity=") - 1);
+      while (!arg.empty())
+      {
+        uint32_t cpu{};
+        auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), cpu);
+        if (error != std::errc{} || (end != arg.data() + arg.size() && *end != ','))
+        {
+          throw std::runtime_error(std::format("Invalid CPU list in {}", argv[i]));
+        }
+        config.affinity.push_back(cpu);
+        arg.remove_prefix(std::min(arg.size(), static_cast<size_t>(end - arg.data()) + 1)); // skip the comma too
+      }
+    }
+  }
+  return config;
+}
+
+int main(int argc, char** argv)
+{
+  WorkerConfig workerConfig = ParseWorkerConfig(argc, argv);
+  ThreadPool workers(workerConfig.threadCount, std::move(workerConfig.affinity));
+
   GLFWwindow* window = CreateWindow({ .maximize = true, .decorate = true, .width = 1280, .height = 720 });
 
   InitOpenGL();
@@ -106,7 +154,7 @@ int main()
   //Game::EntityManager entityManager;
   //GFX::Camera camera;
   world.io = &ImGui::GetIO();
-  Game::Physics physics;
+  Game::Physics physics(workers);
   world.camera.proj = glm::perspective(glm::radians(90.0f), static_cast<float>(frameWidth) / frameHeight, 0.10f, 1000.0f);
   world.camera.viewInfo.position = { -5.5, 3, 0 };
   physics.SetWorld(&world);
@@ -114,6 +162,8 @@ int main()
   world.LoadLevel(*Game::levels[0], &physics);
 
   double prevFrame = glfwGetTime();
+  uint32_t lastDrawTick = 0; // entity manager tick of the previous draw
+  bool showPhysicsMemory = false;
   while (!glfwWindowShouldClose(window))
   {
     glfwPollEvents();
@@ -141,6 +191,15 @@ int main()
       world.cheats = !world.cheats;
     }
 
+    if (world.io->KeysDownDuration[GLFW_KEY_F10] == 0.0f)
+    {
+      showPhysicsMemory = !showPhysicsMemory;
+    }
+    if (showPhysicsMemory)
+    {
+      physics.DrawMemoryStats();
+    }
+
     // disable mouse if game is unpaused
     if (world.gameState == GameState::UNPAUSED)
     {
@@ -200,7 +259,7 @@ int main()
 
       if (ImGui::Button("Restart Level", { -1, 0 }))
       {
-        world.LoadLevel(*world.currentLevel, &physics);
+        world.RestartLevel(&physics);
       }
 
       if (ImGui::Button("Quit", { -1, 0 }))
@@ -263,7 +322,8 @@ int main()
           "E          : pick up bomb\n"
           "F (hold)   : bomb placement guide\n"
           "F (release): place bomb\n"
-          "Escape     : pause/unpause game"
+          "Escape     : pause/unpause game\n"
+          "F10        : PhysX memory stats"
         );
         ImGui::TreePop();
       }
@@ -340,7 +400,7 @@ int main()
       ImGui::Text("%s", deathMessages[rand() % IM_ARRAYSIZE(deathMessages)]);
       if (ImGui::Button("Retry", { -1, 0 }))
       {
-        world.LoadLevel(*world.currentLevel, &physics);
+        world.RestartLevel(&physics);
       }
 
       ImGui::NewLine();
@@ -371,7 +431,7 @@ int main()
 
         if (ImGui::Button("Replay Level", { -1, 0 }))
         {
-          world.LoadLevel(*world.currentLevel, &physics);
+          world.RestartLevel(&physics);
         }
 
         ImGui::End();
@@ -417,12 +477,45 @@ int main()
 
 
     // draw everything
-    auto& objects = world.entityManager.GetObjects();
-    renderer.BeginDraw(objects.size());
-    std::for_each(std::execution::par_unseq, objects.begin(), objects.end(), [&renderer](const auto& obj)
+    // model matrices are only rebuilt for entities whose transform changed since the last draw. Everything is still
+    // submitted every frame: the renderer sets uniforms and issues one draw per object, so there's no persistent
+    // instance buffer that unchanged entities could be left out of
+    // objects that moved in the last physics step are drawn blended between their last two poses
+    // chunks are spread over the same workers that run physics and particles
+    renderer.BeginDraw(static_cast<uint32_t>(world.entityManager.Size()), static_cast<uint32_t>(world.particles.Size()));
+    const uint32_t lastStep = physics.LastStep();
+    const float alpha = physics.InterpolationAlpha();
+    world.entityManager.EachChunk<Transform, Game::Changed<Transform>, PreviousPose, CachedModel, MeshHandle, Renderable>(workers,
+      [&renderer, lastDrawTick, lastStep, alpha](size_t count, const Transform* transforms, const Game::Changed<Transform>* changed,
+        const PreviousPose* previous, CachedModel* models, const MeshHandle* meshes, const Renderable* renderables)
+      {
+        for (size_t i = 0; i < count; i++)
+        {
+          if (changed[i].tick > lastDrawTick)
+          {
+            models[i].model = transforms[i].GetModel();
+          }
+
+          if (previous[i].step == lastStep)
+          {
+            Transform blended = transforms[i];
+            blended.position = glm::mix(previous[i].position, transforms[i].position, alpha);
+            blended.rotation = glm::slerp(previous[i].rotation, transforms[i].rotation, alpha);
+            renderer.Submit(blended.GetModel(), meshes[i], renderables[i]);
+          }
+          else
+          {
+            renderer.Submit(models[i].model, meshes[i], renderables[i]);
+          }
+        }
+      });
+    lastDrawTick = world.entityManager.CurrentTick();
+
+    world.particles.ForEach([&renderer](glm::vec3 position, float scale)
       {
-        renderer.Submit(obj.transform, obj.mesh, obj.renderable);
+        renderer.SubmitParticle({ .position = position, .radius = scale, .glow = PARTICLE_GLOW });
       });
+    world.entityManager.EndFrame();
     renderer.EndDraw(world.camera, dt);
 
     ImGui::Render();
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <compare>
+#include <execution>
+#include <type_traits>
+#include <cassert>
+
+// array made of fixed-size chunks, so growing never moves existing elements and references stay valid
+// until the element itself is removed
+template<typename T, size_t ChunkSize = 1024>
+class ChunkedArray
+{
+  static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize must be a power of two");
+
+  template<bool Const>
+  class Iterator
+  {
+    using Array = std::conditional_t<Const, const ChunkedArray, ChunkedArray>;
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T*, T*>;
+    using reference = std::conditional_t<Const, const T&, T&>;
+
+    Iterator() = default;
+    Iterator(Array* array, size_t index) : array_(array), index_(index) {}
+
+    reference operator*() const { return (*array_)[index_]; }
+    pointer operator->() const { return &(*array_)[index_]; }
+    reference operator[](difference_type n) const { return (*array_)[index_ + n]; }
+
+    Iterator& operator++() { ++index_; return *this; }
+    Iterator operator++(int) { auto t = *this; ++index_; return t; }
+    Iterator& operator--() { --index_; return *this; }
+    Iterator operator--(int) { auto t = *this; --index_; return t; }
+    Iterator& operator+=(difference_type n) { index_ += n; return *this; }
+    Iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+    Iterator operator+(difference_type n) const { return { array_, index_ + n }; }
+    Iterator operator-(difference_type n) const { return { array_, index_ - n }; }
+    friend Iterator operator+(difference_type n, const Iterator& it) { return it + n; }
+    difference_type operator-(const Iterator& other) const { return difference_type(index_) - difference_type(other.index_); }
+
+    bool operator==(const Iterator& other) const { return index_ == other.index_; }
+    auto operator<=>(const Iterator& other) const { return index_ <=> other.index_; }
+
+  private:
+    Array* array_{};
+    size_t index_{};
+  };
+
+public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  static constexpr size_t chunk_size = ChunkSize;
+
+  T& operator[](size_t i) { assert(i < size_); return chunks_[i / ChunkSize][i % ChunkSize]; }
+  const T& operator[](size_t i) const { assert(i < size_); return chunks_[i / ChunkSize][i % ChunkSize]; }
+
+  T& back() { return (*this)[size_ - 1]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return chunks_.size() * ChunkSize; }
+  size_t chunk_count() const { return (size_ + ChunkSize - 1) / ChunkSize; }
+  T* chunk_data(size_t c) { return chunks_[c].get(); }
+  const T* chunk_data(size_t c) const { return chunks_[c].get(); }
+
+  void push_back(const T& value)
+  {
+    if (size_ == capacity())
+    {
+      chunks_.push_back(std::make_unique<T[]>(ChunkSize));
+    }
+    chunks_[size_ / ChunkSize][size_ % ChunkSize] = value;
+    size_++;
+  }
+
+  // appends count copies of value, filling whole chunks at a time
+  void append(size_t count, const T& value)
+  {
+    reserve(size_ + count);
+    while (count > 0)
+    {
+      const size_t offset = size_ % ChunkSize;
+      const size_t n = std::min(count, ChunkSize - offset);
+      std::fill_n(chunks_[size_ / ChunkSize].get() + offset, n, value);
+      size_ += n;
+      count -= n;
+    }
+  }
+
+  void pop_back()
+  {
+    assert(size_ > 0);
+    size_--;
+    chunks_[size_ / ChunkSize][size_ % ChunkSize] = T{};
+  }
+
+  // allocates chunks up front so that pushing up to count elements never allocates
+  void reserve(size_t count)
+  {
+    while (capacity() < count)
+    {
+      chunks_.push_back(std::make_unique<T[]>(ChunkSize));
+    }
+  }
+
+  // copies the elements of other, reusing the chunks this array already owns
+  void assign(const ChunkedArray& other)
+  {
+    for (size_t i = other.size_; i < size_; i++)
+    {
+      (*this)[i] = T{};
+    }
+    reserve(other.size_);
+    for (size_t c = 0; c < other.chunk_count(); c++)
+    {
+      const size_t first = c * ChunkSize;
+      std::copy_n(other.chunks_[c].get(), std::min(ChunkSize, other.size_ - first), chunks_[c].get());
+    }
+    size_ = other.size_;
+  }
+
+  // chunks are kept around for reuse
+  void clear()
+  {
+    for (size_t i = 0; i < size_; i++)
+    {
+      (*this)[i] = T{};
+    }
+    size_ = 0;
+  }
+
+  // calls fn(T* data, size_t first, size_t count) once per chunk, where data points to element first
+  template<typename Fn>
+  void for_each_chunk(Fn&& fn)
+  {
+    for (size_t c = 0; c < chunk_count(); c++)
+    {
+      const size_t first = c * ChunkSize;
+      fn(chunks_[c].get(), first, std::min(ChunkSize, size_ - first));
+    }
+  }
+
+  template<typename Fn>
+  void for_each_chunk(Fn&& fn) const
+  {
+    for (size_t c = 0; c < chunk_count(); c++)
+    {
+      const size_t first = c * ChunkSize;
+      fn(static_cast<const T*>(chunks_[c].get()), first, std::min(ChunkSize, size_ - first));
+    }
+  }
+
+  // same as above, but chunks are visited according to an execution policy, or spread over a worker pool with a
+  // ParallelFor(count, grain, fn) member (one chunk per job)
+  template<typename ExecutionPolicy, typename Fn>
+  void for_each_chunk(ExecutionPolicy&& policy, Fn&& fn)
+  {
+    if constexpr (std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>)
+    {
+      std::for_each(policy, chunks_.begin(), chunks_.begin() + chunk_count(), [&](const std::unique_ptr<T[]>& chunk)
+        {
+          const size_t first = (&chunk - chunks_.data()) * ChunkSize;
+          fn(chunk.get(), first, std::min(ChunkSize, size_ - first));
+        });
+    }
+    else
+    {
+      policy.ParallelFor(chunk_count(), 1, [&](size_t c)
+        {
+          const size_t first = c * ChunkSize;
+          fn(chunks_[c].get(), first, std::min(ChunkSize, size_ - first));
+        });
+    }
+  }
+
+  iterator begin() { return { this, 0 }; }
+  iterator end() { return { this, size_ }; }
+  const_iterator begin() const { return { this, 0 }; }
+  const_iterator end() const { return { this, size_ }; }
+
+private:
+  std::vector<std::unique_ptr<T[]>> chunks_;
+  size_t size_{};
+};
\ No newline at end of file
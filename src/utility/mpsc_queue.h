@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <cstddef>
+
+// bounded lock-free queue that any number of threads can push to while a single thread pops.
+// Every slot has a sequence number that tells whose turn it is: producers claim slots by bumping the tail, and the
+// consumer only reads a slot once its producer has published it
+template<typename T, size_t Capacity>
+class MpscQueue
+{
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>, "T is copied in and out of the slots");
+
+public:
+  MpscQueue()
+  {
+    for (size_t i = 0; i < Capacity; i++)
+    {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // safe to call from any thread. Returns false if the queue is full
+  bool TryPush(const T& value)
+  {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      Slot& slot = slots_[pos & (Capacity - 1)];
+      const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+      if (diff == 0)
+      {
+        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          slot.value = value;
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+      {
+        return false; // the consumer hasn't freed this slot yet
+      }
+      else
+      {
+        pos = tail_.load(std::memory_order_relaxed); // another producer claimed it first
+      }
+    }
+  }
+
+  // only one thread may pop. Returns false if the queue is empty
+  bool TryPop(T& value)
+  {
+    Slot& slot = slots_[head_ & (Capacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+    {
+      return false;
+    }
+
+    value = slot.value;
+    slot.sequence.store(head_ + Capacity, std::memory_order_release);
+    head_++;
+    return true;
+  }
+
+private:
+  struct alignas(64) Slot
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(Capacity);
+  alignas(64) std::atomic<size_t> tail_{ 0 };
+  alignas(64) size_t head_{ 0 };
+};
\ No newline at end of file
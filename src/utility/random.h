@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <span>
+#include <bit>
+#include <cstdint>
+
+// xoshiro256+ running several independent streams side by side. Every step advances all lanes with plain loops over
+// the lanes, which compilers turn into SIMD, so filling arrays costs a fraction of generating values one at a time
+class RandomStream
+{
+public:
+  static constexpr size_t lanes = 8;
+
+  explicit RandomStream(uint64_t seed = 0) { Seed(seed); }
+
+  // the same seed always produces the same sequence
+  void Seed(uint64_t seed)
+  {
+    // splitmix64 spreads one seed over the whole state, as recommended for xoshiro
+    for (size_t l = 0; l < lanes; l++)
+    {
+      s0_[l] = SplitMix(seed);
+      s1_[l] = SplitMix(seed);
+      s2_[l] = SplitMix(seed);
+      s3_[l] = SplitMix(seed);
+    }
+  }
+
+  // fills out with uniform floats in [low, high)
+  void Fill(std::span<float> out, float low = 0.0f, float high = 1.0f)
+  {
+    const float scale = (high - low) * 0x1.0p-24f;
+    std::array<uint64_t, lanes> bits;
+    for (size_t i = 0; i < out.size(); i += lanes)
+    {
+      Next(bits);
+      const size_t count = out.size() - i < lanes ? out.size() - i : lanes;
+      for (size_t l = 0; l < count; l++)
+      {
+        // the upper bits of xoshiro256+ are the best ones
+        out[i + l] = static_cast<float>(bits[l] >> 40) * scale + low;
+      }
+    }
+  }
+
+private:
+  static uint64_t SplitMix(uint64_t& x)
+  {
+    uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+
+  void Next(std::array<uint64_t, lanes>& result)
+  {
+    for (size_t l = 0; l < lanes; l++)
+    {
+      result[l] = s0_[l] + s3_[l];
+      const uint64_t t = s1_[l] << 17;
+      s2_[l] ^= s0_[l];
+      s3_[l] ^= s1_[l];
+      s1_[l] ^= s2_[l];
+      s0_[l] ^= s3_[l];
+      s2_[l] ^= t;
+      s3_[l] = std::rotl(s3_[l], 45);
+    }
+  }
+
+  alignas(64) std::array<uint64_t, lanes> s0_;
+  alignas(64) std::array<uint64_t, lanes> s1_;
+  alignas(64) std::array<uint64_t, lanes> s2_;
+  alignas(64) std::array<uint64_t, lanes> s3_;
+};
\ No newline at end of file
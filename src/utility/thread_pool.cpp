@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+#if defined(_WIN32)
+  #define WIN32_LEAN_AND_MEAN
+  #define NOMINMAX
+  #include <Windows.h>
+#elif defined(__linux__)
+  #include <pthread.h>
+  #include <sched.h>
+#endif
+
+namespace
+{
+  void PinCurrentThread(uint32_t cpu)
+  {
+#if defined(_WIN32)
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu; // no affinity support, the OS schedules the workers
+#endif
+  }
+}
+
+ThreadPool::ThreadPool(size_t threadCount, std::vector<uint32_t> affinity)
+  : affinity_(std::move(affinity))
+{
+  workers_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++)
+  {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::scoped_lock lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_)
+  {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::DefaultThreadCount()
+{
+  const size_t cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 0;
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+  if (workers_.empty())
+  {
+    job();
+    return;
+  }
+
+  {
+    std::scoped_lock lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  wake_.notify_one();
+}
+
+void ThreadPool::WorkerLoop(size_t index)
+{
+  if (!affinity_.empty())
+  {
+    PinCurrentThread(affinity_[index % affinity_.size()]);
+  }
+
+  for (;;)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty())
+      {
+        return; // stopping, and everything that was submitted has run
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job();
+  }
+}
\ No newline at end of file
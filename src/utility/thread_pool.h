@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+// fixed set of worker threads shared by everything that wants to run in parallel (physics, particles, draw submission).
+// Workers can be pinned to CPUs: worker i runs on affinity[i % affinity.size()]
+class ThreadPool
+{
+public:
+  // threadCount can be zero, in which case everything runs on the thread that submits it
+  explicit ThreadPool(size_t threadCount, std::vector<uint32_t> affinity = {});
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // workers for everything but the main thread, which is kept for the game itself
+  static size_t DefaultThreadCount();
+
+  size_t ThreadCount() const { return workers_.size(); }
+
+  // runs job on a worker, or right away if there are no workers
+  void Submit(std::function<void()> job);
+
+  // calls fn(i) for every i in [0, count), in batches of grain indices. The calling thread works on batches too, so
+  // this makes progress even when every worker is busy, and it returns once every call is done
+  template<typename Fn>
+  void ParallelFor(size_t count, size_t grain, Fn&& fn)
+  {
+    grain = std::max<size_t>(grain, 1);
+    const size_t batches = (count + grain - 1) / grain;
+    if (batches <= 1 || workers_.empty())
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        fn(i);
+      }
+      return;
+    }
+
+    // helpers that only start after every batch is taken still look at the counters, so those outlive this call
+    struct Progress
+    {
+      std::atomic<size_t> next{ 0 };
+      std::atomic<size_t> remaining{ 0 };
+    };
+    auto progress = std::make_shared<Progress>();
+    progress->remaining.store(batches);
+
+    auto work = [progress, count, grain, batches, f = &fn]
+    {
+      for (size_t b; (b = progress->next.fetch_add(1)) < batches;)
+      {
+        const size_t last = std::min(count, (b + 1) * grain);
+        for (size_t i = b * grain; i < last; i++)
+        {
+          (*f)(i);
+        }
+        if (progress->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          progress->remaining.notify_all();
+        }
+      }
+    };
+
+    for (size_t h = 0; h < std::min(batches - 1, workers_.size()); h++)
+    {
+      Submit(work);
+    }
+    work();
+
+    for (size_t r; (r = progress->remaining.load(std::memory_order_acquire)) != 0;)
+    {
+      progress->remaining.wait(r);
+    }
+  }
+
+private:
+  void WorkerLoop(size_t index);
+
+  std::vector<uint32_t> affinity_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> jobs_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
\ No newline at end of file
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <span>
+
 #include <imgui.h>
 #include "gfx/camera.h"
 #include "game/game.h"
 #include "game/physics.h"
+#include "game/particles.h"
+#include "utility/random.h"
 #include "game/level.h"
 
 #define DEBUG_PRINT 0
@@ -24,6 +28,15 @@ constexpr float EXPLOSION_MAX_OBJECT_DIST = 10.0;
 constexpr float EXPLOSION_PLAYER_FORCE = 20.0;
 constexpr float EXPLOSION_MIN_PLAYER_FORCE = 10.0;
 constexpr float EXPLOSION_OBJECT_FORCE = 30.0;
+constexpr size_t EXPLOSION_PARTICLES = 150;
+constexpr double EXPLOSION_CHAIN_DELAY = 0.05; // seconds between an explosion and the explosives it sets off
+constexpr size_t MAX_EXPLOSIONS_PER_TICK = 4; // clusters of explosions beyond this are pushed to the following ticks
+constexpr float EXPLOSION_CLUSTER_RADIUS = 3.0; // explosives going off in the same tick this close are merged
+constexpr size_t EXPLOSION_CLUSTER_PARTICLES = 300; // most particles a cluster emits, however many explosives it has
+
+constexpr size_t MAX_PARTICLES = 20000;
+constexpr size_t PARTICLE_EMIT_BUDGET = 3000; // per physics tick, shared by every explosion in that tick
+constexpr glm::vec3 PARTICLE_GLOW{ .4, .2, .1 };
 
 constexpr float PLAYER_HEIGHT = 2.0f;
 constexpr float PLAYER_RADIUS = 0.7f;
@@ -59,15 +72,24 @@ struct World
   ImGuiIO* io{};
   GFX::Camera camera;
   Game::EntityManager entityManager;
+  Game::ParticleSystem particles{ MAX_PARTICLES, PARTICLE_EMIT_BUDGET };
+
+  // reseeded whenever a level is (re)started, so replaying a level gives the same explosions
+  uint64_t seed = 0x4c443439;
+  RandomStream rng{ seed };
 
   const Game::Level* currentLevel = nullptr;
 
+  // state of the current level right after loading, so restarting doesn't have to rebuild it
+  const Game::Level* snapshotLevel = nullptr;
+  Game::EntityManager::Snapshot levelSnapshot;
+
   MeshHandle sphereMeshHandle;
   MeshHandle cubeMeshHandle;
 
-  Game::GameObject& MakeSphere(glm::vec3 pos, float scale)
+  Game::GameObject MakeSphere(glm::vec3 pos, float scale, EntityType type = EntityType::REGULAR)
   {
-    Game::GameObject& obj = entityManager.GetObject(entityManager.CreateEntity());
+    Game::GameObject obj = entityManager.GetObject(entityManager.CreateEntity(type));
     obj.transform.position = pos;
     obj.transform.scale = glm::vec3(scale);
     obj.mesh = sphereMeshHandle;
@@ -75,9 +97,9 @@ struct World
     return obj;
   }
 
-  Game::GameObject& MakeBox(glm::vec3 pos, glm::vec3 halfExtents)
+  Game::GameObject MakeBox(glm::vec3 pos, glm::vec3 halfExtents, EntityType type = EntityType::REGULAR)
   {
-    Game::GameObject& obj = entityManager.GetObject(entityManager.CreateEntity());
+    Game::GameObject obj = entityManager.GetObject(entityManager.CreateEntity(type));
     obj.transform.position = pos;
     obj.transform.scale = glm::vec3(halfExtents);
     obj.mesh = cubeMeshHandle;
@@ -85,25 +107,63 @@ struct World
     return obj;
   }
 
-  Game::GameObject& MakeExplosive(glm::vec3 pos, Game::Physics* physics)
+  Game::Prefab ExplosivePrefab() const
+  {
+    Game::Prefab prefab{ .type = EntityType::EXPLOSIVE };
+    prefab.transform.scale = glm::vec3(EXPLOSIVE_SIZE);
+    prefab.mesh = cubeMeshHandle;
+    prefab.renderable.visible = true;
+    prefab.renderable.color = EXPLOSIVE_COLOR;
+    prefab.renderable.glow = EXPLOSIVE_BASE_GLOW;
+    return prefab;
+  }
+
+  Game::Prefab PlatformPrefab(glm::vec3 halfExtents) const
+  {
+    Game::Prefab prefab{ .type = EntityType::TERRAIN };
+    prefab.transform.scale = halfExtents;
+    prefab.mesh = cubeMeshHandle;
+    prefab.renderable.visible = true;
+    return prefab;
+  }
+
+  Game::GameObject MakeExplosive(glm::vec3 pos, Game::Physics* physics)
   {
-    Game::GameObject& obj = MakeBox(pos, glm::vec3(EXPLOSIVE_SIZE));
-    obj.renderable.color = EXPLOSIVE_COLOR;
-    obj.type = EntityType::EXPLOSIVE;
+    Game::GameObject obj = entityManager.GetObject(entityManager.Spawn(ExplosivePrefab()));
+    obj.transform.position = pos;
     Game::Box box{ glm::vec3(EXPLOSIVE_SIZE) };
     physics->AddObject(obj.entity, Game::MaterialType::OBJECT, &box);
     return obj;
   }
 
-  Game::GameObject& MakePlatform(glm::vec3 pos, glm::vec3 halfExtents, Game::Physics* physics)
+  Game::GameObject MakePlatform(glm::vec3 pos, glm::vec3 halfExtents, Game::Physics* physics)
   {
-    Game::GameObject& obj = MakeBox(pos, halfExtents);
-    obj.type = EntityType::TERRAIN;
+    Game::GameObject obj = MakeBox(pos, halfExtents, EntityType::TERRAIN);
     Game::Box box{ halfExtents };
     physics->AddObject(obj.entity, Game::MaterialType::TERRAIN, &box);
     return obj;
   }
 
+  void SpawnExplosives(std::span<const glm::vec3> positions, Game::Physics* physics)
+  {
+    const Game::Box box{ glm::vec3(EXPLOSIVE_SIZE) };
+    entityManager.SpawnBatch(ExplosivePrefab(), positions.size(), [&](size_t i, Game::GameObject obj)
+      {
+        obj.transform.position = positions[i];
+        physics->AddObject(obj.entity, Game::MaterialType::OBJECT, &box);
+      });
+  }
+
+  void SpawnPlatforms(std::span<const glm::vec3> positions, glm::vec3 halfExtents, Game::Physics* physics)
+  {
+    const Game::Box box{ halfExtents };
+    entityManager.SpawnBatch(PlatformPrefab(halfExtents), positions.size(), [&](size_t i, Game::GameObject obj)
+      {
+        obj.transform.position = positions[i];
+        physics->AddObject(obj.entity, Game::MaterialType::TERRAIN, &box);
+      });
+  }
+
   void LoadLevel(const Game::Level& level, Game::Physics* physics)
   {
     gameState = GameState::PAUSED;
@@ -111,40 +171,44 @@ struct World
     camera.viewInfo.pitch = 0;
     camera.viewInfo.yaw = 0;
     entityManager.Clear();
+    particles.Clear();
+    rng.Seed(seed);
     physics->Reset();
 
-    for (glm::vec3 pos : level.bombs)
-    {
-      MakeExplosive(pos, physics);
-    }
-
-    for (glm::vec3 pos : level.smallPlatforms)
-    {
-      MakePlatform(pos, SMALL_PLATFORM_SIZE, physics);
-    }
-
-    for (glm::vec3 pos : level.mediumPlatforms)
-    {
-      MakePlatform(pos, MEDIUM_PLATFORM_SIZE, physics);
-    }
-
-    for (glm::vec3 pos : level.largePlatforms)
-    {
-      MakePlatform(pos, LARGE_PLATFORM_SIZE, physics);
-    }
-
-    for (auto& [pos, size] : level.customPlatforms)
-    {
-      MakePlatform(pos, size, physics);
-    }
-
-    auto& win = MakePlatform(level.winPlatformPos, level.winPlatformSize, physics);
+    SpawnExplosives(level.bombs, physics);
+    SpawnPlatforms(level.smallPlatforms, SMALL_PLATFORM_SIZE, physics);
+    SpawnPlatforms(level.mediumPlatforms, MEDIUM_PLATFORM_SIZE, physics);
+    SpawnPlatforms(level.largePlatforms, LARGE_PLATFORM_SIZE, physics);
+
+    // custom platforms all have different sizes, so the size is overridden per instance
+    entityManager.SpawnBatch(PlatformPrefab(glm::vec3(1)), level.customPlatforms.size(), [&](size_t i, Game::GameObject obj)
+      {
+        const auto& [pos, size] = level.customPlatforms[i];
+        obj.transform.position = pos;
+        obj.transform.scale = size;
+        Game::Box box{ size };
+        physics->AddObject(obj.entity, Game::MaterialType::TERRAIN, &box);
+      });
+
+    auto win = MakePlatform(level.winPlatformPos, level.winPlatformSize, physics);
     win.physics.isWinPlatform = true;
     win.renderable.glow = { 0, .4, .9 };
     win.renderable.color = { .05, .05, .05, 1.0 };
 
+    // particles bounce off of every platform, which never move
+    std::vector<Game::Aabb> colliders;
+    entityManager.Each<Transform>(EntityType::TERRAIN, [&colliders](const Transform& transform)
+      {
+        colliders.push_back({ transform.position - transform.scale, transform.position + transform.scale });
+      });
+    particles.SetColliders(colliders);
+
     bombInventory = level.startBombs;
 
+    entityManager.SaveSnapshot(levelSnapshot);
+    physics->SaveSnapshot();
+    snapshotLevel = &level;
+
     physics->SetPlayerPos(level.startPos);
 
     // epic hack
@@ -152,4 +216,29 @@ struct World
 
     DEBUG_PRINT(LoadLevela);
   }
+
+  // puts the current level back into its just-loaded state in place, reusing its entities and actors
+  void RestartLevel(Game::Physics* physics)
+  {
+    if (snapshotLevel != currentLevel)
+    {
+      LoadLevel(*currentLevel, physics);
+      return;
+    }
+
+    gameState = GameState::PAUSED;
+    camera.viewInfo.pitch = 0;
+    camera.viewInfo.yaw = 0;
+    entityManager.LoadSnapshot(levelSnapshot);
+    particles.Clear();
+    rng.Seed(seed);
+    physics->RestoreSnapshot();
+
+    bombInventory = currentLevel->startBombs;
+
+    physics->SetPlayerPos(currentLevel->startPos);
+
+    // epic hack
+    physics->Simulate(0);
+  }
 };
\ No newline at end of file